@@ -0,0 +1,203 @@
+/**
+ * admission.c - Bộ lọc nhận page kiểu W-TinyLFU
+ *
+ * Count-min sketch 4 hàng (counter 8 bit, bão hòa ở 15) ước lượng tần suất
+ * truy cập mỗi key, được chia đôi sau mỗi 10 x page_count lần ghi nhận để
+ * quên dần quá khứ. Page mới luôn vào một cửa sổ FIFO nhỏ (~1% shard,
+ * PAGE_WINDOW); khi shard đầy, page cũ nhất của cửa sổ chỉ được vào policy
+ * nếu tần suất ước lượng cao hơn victim mà policy chọn, nếu không thì chính
+ * nó bị evict.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "vtpc_internal.h"
+
+#define SKETCH_DEPTH 4
+#define SKETCH_MAX   15
+
+struct admission {
+    uint8_t *counters;      /* SKETCH_DEPTH hàng, mỗi hàng width counter */
+    size_t width_mask;
+    atomic_size_t additions;
+    size_t sample_size;
+
+    page_queue_t window;
+    size_t window_target;
+};
+
+static size_t sketch_index(const admission_t *adm, uint64_t h, unsigned row) {
+    /* Double hashing: mỗi hàng một vị trí độc lập từ cùng một hash */
+    uint64_t step = (h >> 32) | 1;
+    return row * (adm->width_mask + 1) + (size_t)((h + row * step) & adm->width_mask);
+}
+
+static unsigned sketch_estimate(const admission_t *adm, uint64_t key) {
+    uint64_t h = hash_key(key);
+    unsigned freq = SKETCH_MAX;
+
+    for (unsigned row = 0; row < SKETCH_DEPTH; row++) {
+        unsigned c = __atomic_load_n(&adm->counters[sketch_index(adm, h, row)], __ATOMIC_RELAXED);
+        if (c < freq) {
+            freq = c;
+        }
+    }
+
+    return freq;
+}
+
+/* Chia đôi mọi counter; gọi dưới lock của shard */
+static void sketch_age(admission_t *adm) {
+    size_t n = SKETCH_DEPTH * (adm->width_mask + 1);
+
+    for (size_t i = 0; i < n; i++) {
+        uint8_t c = __atomic_load_n(&adm->counters[i], __ATOMIC_RELAXED);
+        __atomic_store_n(&adm->counters[i], (uint8_t)(c >> 1), __ATOMIC_RELAXED);
+    }
+
+    atomic_store_explicit(&adm->additions, 0, memory_order_relaxed);
+}
+
+int admission_init(cache_shard_t *shard) {
+    admission_t *adm = calloc(1, sizeof(admission_t));
+    if (adm == NULL) {
+        return -1;
+    }
+
+    size_t width = 64;
+    while (width < shard->page_count) {
+        width *= 2;
+    }
+
+    adm->counters = calloc(SKETCH_DEPTH * width, sizeof(uint8_t));
+    if (adm->counters == NULL) {
+        free(adm);
+        return -1;
+    }
+
+    adm->width_mask = width - 1;
+    adm->sample_size = 10 * shard->page_count;
+    atomic_init(&adm->additions, 0);
+
+    queue_init(&adm->window);
+    adm->window_target = shard->page_count / 100;
+    if (adm->window_target == 0) {
+        adm->window_target = 1;
+    }
+
+    shard->admission = adm;
+
+    return 0;
+}
+
+void admission_destroy(cache_shard_t *shard) {
+    admission_t *adm = shard->admission;
+
+    if (adm != NULL) {
+        free(adm->counters);
+        free(adm);
+    }
+    shard->admission = NULL;
+}
+
+size_t admission_bytes(const cache_shard_t *shard) {
+    const admission_t *adm = shard->admission;
+
+    return sizeof(admission_t) + SKETCH_DEPTH * (adm->width_mask + 1);
+}
+
+/*
+ * Ghi nhận một lần truy cập; có thể gọi không lock. Tăng đồng thời có thể
+ * vượt SKETCH_MAX một chút, không ảnh hưởng vì counter được chia đôi định kỳ.
+ */
+void admission_record(cache_shard_t *shard, uint64_t key) {
+    admission_t *adm = shard->admission;
+    uint64_t h = hash_key(key);
+
+    for (unsigned row = 0; row < SKETCH_DEPTH; row++) {
+        uint8_t *c = &adm->counters[sketch_index(adm, h, row)];
+        if (__atomic_load_n(c, __ATOMIC_RELAXED) < SKETCH_MAX) {
+            __atomic_fetch_add(c, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    atomic_fetch_add_explicit(&adm->additions, 1, memory_order_relaxed);
+}
+
+/* Page mới vào cửa sổ; phần tràn (khi shard còn chỗ) vào thẳng policy */
+void admission_insert(cache_shard_t *shard, page_id_t page) {
+    admission_t *adm = shard->admission;
+
+    if (atomic_load_explicit(&adm->additions, memory_order_relaxed) >= adm->sample_size) {
+        sketch_age(adm);
+    }
+
+    page_set(page, PAGE_WINDOW);
+    queue_push_back(&adm->window, page);
+
+    while (adm->window.count > adm->window_target) {
+        page_id_t oldest = queue_pop_front(&adm->window);
+        page_clear(oldest, PAGE_WINDOW);
+        g_cache.policy->on_insert(shard, oldest, false);
+    }
+}
+
+void admission_remove(cache_shard_t *shard, page_id_t page) {
+    queue_remove(&shard->admission->window, page);
+    page_clear(page, PAGE_WINDOW);
+}
+
+static page_id_t window_candidate(const admission_t *adm) {
+    for (page_id_t page = adm->window.head; page != PAGE_NONE; page = g_cache.page_links[page].next) {
+        if (page_evictable(page)) {
+            return page;
+        }
+    }
+
+    return PAGE_NONE;
+}
+
+/*
+ * Cuộc đấu giữa page cũ nhất của cửa sổ và victim của policy: bên có tần
+ * suất ước lượng thấp hơn bị evict, bên thắng ở lại trong policy.
+ */
+page_id_t admission_choose_victim(cache_shard_t *shard) {
+    admission_t *adm = shard->admission;
+    page_id_t candidate = window_candidate(adm);
+    page_id_t victim = g_cache.policy->choose_victim(shard);
+
+    if (candidate == PAGE_NONE) {
+        return victim;
+    }
+    if (victim == PAGE_NONE) {
+        return candidate;
+    }
+
+    if (sketch_estimate(adm, page_key_of(candidate)) > sketch_estimate(adm, page_key_of(victim))) {
+        admission_remove(shard, candidate);
+        g_cache.policy->on_insert(shard, candidate, false);
+        shard->admissions_accepted++;
+        return victim;
+    }
+
+    /* Victim dirty sẽ được ghi rồi đấu lại, chỉ đếm lần evict thật */
+    if (!page_test(candidate, PAGE_DIRTY)) {
+        shard->admissions_rejected++;
+    }
+    return candidate;
+}
+
+/*
+ * Cho luồng thu hồi: chỉ chọn khi cửa sổ có page để đấu. Ngay sau một miss
+ * cửa sổ có thể chỉ còn page đang nạp; evict victim của policy lúc đó sẽ
+ * để page mới vào thẳng policy mà không qua bộ lọc.
+ */
+page_id_t admission_reclaim_victim(cache_shard_t *shard) {
+    if (window_candidate(shard->admission) == PAGE_NONE) {
+        errno = EBUSY;
+        return PAGE_NONE;
+    }
+
+    return admission_choose_victim(shard);
+}
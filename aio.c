@@ -0,0 +1,484 @@
+/**
+ * aio.c - Đọc/ghi bất đồng bộ
+ *
+ * vtpc_read_async()/vtpc_write_async() làm ngay khi lấy được file->lock mà
+ * không chờ và mọi page của dải đã có trong cache; còn lại yêu cầu được
+ * xếp hàng cho VTPC_AIO_THREADS worker. Worker nạp page mà không giữ
+ * file->lock, nên nhiều miss (kể cả trên cùng file) chạy đồng thời và các
+ * block liên tiếp của một yêu cầu đi chung một lần preadv; chỉ lần chép ra
+ * buffer mới giữ file->lock.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "vtpc.h"
+#include "vtpc_internal.h"
+
+/* Số byte đọc được từ offset, đã cắt theo file_size; gọi dưới file->lock */
+static size_t read_span(const file_entry_t *file, const vtpc_aio_t *aio) {
+    if (aio->offset >= file->file_size) {
+        return 0;
+    }
+    if ((off_t)aio->count > file->file_size - aio->offset) {
+        return (size_t)(file->file_size - aio->offset);
+    }
+    return aio->count;
+}
+
+/* Số page của dải [offset, offset + len), len > 0 */
+static size_t span_pages(off_t offset, size_t len) {
+    off_t page_size = (off_t)g_cache.page_size;
+
+    return (size_t)((offset + (off_t)len - 1) / page_size - offset / page_size + 1);
+}
+
+/*
+ * Chép từ các page liên tiếp đã pin, page đầu chứa offset. Gọi dưới
+ * file->lock để không đọc page đang bị vtpc_write() ghi dở.
+ */
+static void copy_from_pages(const page_id_t *pages, off_t offset, char *dst, size_t len) {
+    size_t page_size = g_cache.page_size;
+    size_t in_page = (size_t)(offset % (off_t)page_size);
+
+    for (size_t i = 0; len > 0; i++) {
+        size_t n = page_size - in_page;
+
+        if (n > len) {
+            n = len;
+        }
+        memcpy(dst, (char *)cache_page_data(pages[i]) + in_page, n);
+        dst += n;
+        len -= n;
+        in_page = 0;
+    }
+}
+
+/* 1 = đã xong, 0 = phải xếp hàng, -1 = lỗi */
+static int read_now(file_entry_t *file, vtpc_aio_t *aio) {
+    page_id_t pages[VTPC_CLUSTER_MAX];
+
+    if (pthread_mutex_trylock(&file->lock) != 0) {
+        return 0;
+    }
+
+    if (!file->in_use || file->closing) {
+        pthread_mutex_unlock(&file->lock);
+        errno = EBADF;
+        return -1;
+    }
+
+    size_t len = read_span(file, aio);
+    size_t n = (len > 0) ? span_pages(aio->offset, len) : 0;
+
+    if (n > VTPC_CLUSTER_MAX ||
+        !cache_try_get_pages(aio->fd, aio->offset / (off_t)g_cache.page_size, n, pages)) {
+        pthread_mutex_unlock(&file->lock);
+        return 0;
+    }
+
+    copy_from_pages(pages, aio->offset, aio->buf, len);
+
+    pthread_mutex_unlock(&file->lock);
+
+    for (size_t i = 0; i < n; i++) {
+        cache_put_page(pages[i], false);
+    }
+
+    aio->result = (ssize_t)len;
+    aio->error = 0;
+
+    return 1;
+}
+
+/* Như read_now(); ghi chạm tới page chưa có hoặc phải chờ ghi ngầm thì xếp hàng */
+static int write_now(file_entry_t *file, vtpc_aio_t *aio) {
+    size_t page_size = g_cache.page_size;
+    page_id_t pages[VTPC_CLUSTER_MAX];
+
+    if (pthread_mutex_trylock(&file->lock) != 0) {
+        return 0;
+    }
+
+    if (!file->in_use || file->closing) {
+        pthread_mutex_unlock(&file->lock);
+        errno = EBADF;
+        return -1;
+    }
+
+    size_t n = (aio->count > 0) ? span_pages(aio->offset, aio->count) : 0;
+
+    if (n > VTPC_CLUSTER_MAX ||
+        (g_cache.writeback.running && atomic_load(&g_cache.dirty_pages) >= g_cache.dirty_limit_pages) ||
+        !cache_try_get_pages(aio->fd, aio->offset / (off_t)page_size, n, pages)) {
+        pthread_mutex_unlock(&file->lock);
+        return 0;
+    }
+
+    const char *src = aio->buf;
+    size_t in_page = (size_t)(aio->offset % (off_t)page_size);
+    size_t left = aio->count;
+
+    for (size_t i = 0; i < n; i++) {
+        size_t len = (page_size - in_page < left) ? page_size - in_page : left;
+
+        cache_page_write_begin(pages[i]);
+        memcpy((char *)cache_page_data(pages[i]) + in_page, src, len);
+        cache_page_write_end(pages[i]);
+        cache_put_page_dirty(pages[i], in_page, len);
+
+        src += len;
+        left -= len;
+        in_page = 0;
+    }
+
+    if (aio->offset + (off_t)aio->count > file->file_size) {
+        file->file_size = aio->offset + (off_t)aio->count;
+    }
+
+    pthread_mutex_unlock(&file->lock);
+
+    aio->result = (ssize_t)aio->count;
+    aio->error = 0;
+
+    return 1;
+}
+
+/*
+ * Đường chậm của worker: nạp tối đa VTPC_CLUSTER_MAX page mỗi lần mà không
+ * giữ file->lock rồi nhả ngay, để nhiều miss chạy đồng thời. Ref dùng để
+ * chép được lấy lại trong cùng đoạn giữ file->lock với lần chép, nên ghi
+ * thẳng hay vtpc_close() (bỏ page dưới file->lock) không bao giờ thấy chúng.
+ */
+static void aio_read(vtpc_aio_t *aio) {
+    file_entry_t *file = get_file_entry(aio->fd);
+    size_t page_size = g_cache.page_size;
+    size_t done = 0;
+
+    pthread_mutex_lock(&file->lock);
+    bool in_use = file->in_use;
+    size_t len = in_use ? read_span(file, aio) : 0;
+    pthread_mutex_unlock(&file->lock);
+
+    int error = in_use ? 0 : EBADF;
+
+    while (done < len) {
+        off_t offset = aio->offset + (off_t)done;
+        off_t first_block = offset / (off_t)page_size;
+        page_id_t pages[VTPC_CLUSTER_MAX];
+        size_t n = cache_get_pages(aio->fd, first_block, span_pages(offset, len - done), 0, pages);
+        if (n == 0) {
+            error = errno;
+            break;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            cache_put_page(pages[i], false);
+        }
+
+        size_t chunk = n * page_size - (size_t)(offset % (off_t)page_size);
+        if (chunk > len - done) {
+            chunk = len - done;
+        }
+
+        /* Page bị evict giữa hai bước thì được nạp lại ở đây, dưới lock */
+        size_t got = 0;
+
+        pthread_mutex_lock(&file->lock);
+        while (got < n) {
+            pages[got] = cache_get_page(aio->fd, first_block + (off_t)got, true, ACCESS_QUIET);
+            if (pages[got] == PAGE_NONE) {
+                error = errno;
+                break;
+            }
+            got++;
+        }
+        if (got == n) {
+            copy_from_pages(pages, offset, (char *)aio->buf + done, chunk);
+        }
+        pthread_mutex_unlock(&file->lock);
+
+        for (size_t i = 0; i < got; i++) {
+            cache_put_page(pages[i], false);
+        }
+        if (got < n) {
+            break;
+        }
+        done += chunk;
+    }
+
+    /* Như read(): lỗi sau khi đã đọc được một phần thì trả về phần đó */
+    aio->result = (done > 0 || error == 0) ? (ssize_t)done : -1;
+    aio->error = (aio->result < 0) ? error : 0;
+}
+
+static void aio_write(vtpc_aio_t *aio) {
+    aio->result = file_pwrite(aio->fd, aio->buf, aio->count, aio->offset);
+    aio->error = (aio->result < 0) ? errno : 0;
+}
+
+/*
+ * Yêu cầu được bỏ khỏi aio_pending trước khi báo, nên callback có thể đóng
+ * file. Sau khi báo, aio thuộc về caller và không được chạm tới nữa.
+ */
+static void aio_complete(vtpc_aio_t *aio) {
+    aio_t *q = &g_cache.aio;
+    void (*callback)(vtpc_aio_t *) = aio->callback;
+
+    pthread_mutex_lock(&q->lock);
+
+    get_file_entry(aio->fd)->aio_pending--;
+    pthread_cond_broadcast(&q->idle);
+
+    if (callback == NULL) {
+        aio->next = NULL;
+        if (q->done_tail != NULL) {
+            q->done_tail->next = aio;
+        } else {
+            q->done_head = aio;
+        }
+        q->done_tail = aio;
+    }
+
+    pthread_mutex_unlock(&q->lock);
+
+    if (callback != NULL) {
+        callback(aio);
+    } else {
+        uint64_t one = 1;
+        ssize_t written = write(q->event_fd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+static void *aio_worker(void *arg) {
+    aio_t *q = &g_cache.aio;
+
+    (void)arg;
+
+    pthread_mutex_lock(&q->lock);
+
+    for (;;) {
+        while (q->head == NULL && !q->stop) {
+            pthread_cond_wait(&q->cond, &q->lock);
+        }
+        /* Khi dừng vẫn làm hết hàng đợi để mọi yêu cầu đều được báo */
+        if (q->head == NULL) {
+            break;
+        }
+
+        vtpc_aio_t *aio = q->head;
+        q->head = aio->next;
+        if (q->head == NULL) {
+            q->tail = NULL;
+        }
+
+        pthread_mutex_unlock(&q->lock);
+
+        if (aio->write) {
+            aio_write(aio);
+        } else {
+            aio_read(aio);
+        }
+        aio_complete(aio);
+
+        pthread_mutex_lock(&q->lock);
+    }
+
+    pthread_mutex_unlock(&q->lock);
+
+    return NULL;
+}
+
+/* Worker được tạo ở yêu cầu đầu tiên phải chờ */
+static int aio_queue(vtpc_aio_t *aio) {
+    aio_t *q = &g_cache.aio;
+    file_entry_t *file = get_file_entry(aio->fd);
+
+    pthread_mutex_lock(&q->lock);
+
+    /* vtpc_close() đã bắt đầu: aio_drain() có thể đã thấy aio_pending = 0 */
+    if (file->closing) {
+        pthread_mutex_unlock(&q->lock);
+        errno = EBADF;
+        return -1;
+    }
+
+    for (size_t i = q->nthreads; i < VTPC_AIO_THREADS; i++) {
+        if (pthread_create(&q->threads[i], NULL, aio_worker, NULL) != 0) {
+            break;
+        }
+        q->nthreads++;
+    }
+    if (q->nthreads == 0) {
+        pthread_mutex_unlock(&q->lock);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    aio->next = NULL;
+    if (q->tail != NULL) {
+        q->tail->next = aio;
+    } else {
+        q->head = aio;
+    }
+    q->tail = aio;
+    file->aio_pending++;
+
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+
+    atomic_fetch_add(&g_cache.aio_queued, 1);
+
+    return 1;
+}
+
+static int aio_submit(vtpc_aio_t *aio, bool write) {
+    if (!g_cache.initialized || aio == NULL || (aio->buf == NULL && aio->count > 0) ||
+        aio->offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    file_entry_t *file = get_file_entry(aio->fd);
+    if (file == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    aio->write = write;
+
+    int done = write ? write_now(file, aio) : read_now(file, aio);
+    if (done != 0) {
+        if (done > 0) {
+            atomic_fetch_add(&g_cache.aio_completed_inline, 1);
+        }
+        return (done > 0) ? 0 : -1;
+    }
+
+    return aio_queue(aio);
+}
+
+int vtpc_read_async(vtpc_aio_t *aio) {
+    return aio_submit(aio, false);
+}
+
+int vtpc_write_async(vtpc_aio_t *aio) {
+    return aio_submit(aio, true);
+}
+
+int vtpc_aio_fd(void) {
+    if (!g_cache.initialized) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return g_cache.aio.event_fd;
+}
+
+size_t vtpc_aio_reap(vtpc_aio_t **done, size_t max) {
+    aio_t *q = &g_cache.aio;
+    size_t n = 0;
+
+    if (!g_cache.initialized || done == NULL) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&q->lock);
+
+    while (n < max && q->done_head != NULL) {
+        done[n++] = q->done_head;
+        q->done_head = q->done_head->next;
+    }
+    if (q->done_head == NULL) {
+        q->done_tail = NULL;
+    }
+
+    pthread_mutex_unlock(&q->lock);
+
+    return n;
+}
+
+int aio_start(void) {
+    aio_t *q = &g_cache.aio;
+
+    q->head = NULL;
+    q->tail = NULL;
+    q->done_head = NULL;
+    q->done_tail = NULL;
+    q->stop = false;
+    q->nthreads = 0;
+
+    q->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (q->event_fd < 0) {
+        return -1;
+    }
+
+    if (pthread_mutex_init(&q->lock, NULL) != 0) {
+        close(q->event_fd);
+        return -1;
+    }
+    pthread_cond_init(&q->cond, NULL);
+    pthread_cond_init(&q->idle, NULL);
+
+    q->running = true;
+
+    return 0;
+}
+
+/* Yêu cầu còn trong hàng đợi được làm xong; yêu cầu chưa được reap bị bỏ */
+void aio_stop(void) {
+    aio_t *q = &g_cache.aio;
+
+    if (!q->running) {
+        return;
+    }
+
+    pthread_mutex_lock(&q->lock);
+    q->stop = true;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+
+    for (size_t i = 0; i < q->nthreads; i++) {
+        pthread_join(q->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&q->idle);
+    pthread_cond_destroy(&q->cond);
+    pthread_mutex_destroy(&q->lock);
+    close(q->event_fd);
+
+    q->event_fd = -1;
+    q->nthreads = 0;
+    q->running = false;
+}
+
+/*
+ * Gọi dưới file->lock. Cờ được ghi dưới cả lock của hàng đợi, nên
+ * aio_queue() (không giữ file->lock) cũng thấy nó.
+ */
+void aio_set_closing(file_entry_t *file, bool closing) {
+    aio_t *q = &g_cache.aio;
+
+    pthread_mutex_lock(&q->lock);
+    file->closing = closing;
+    pthread_mutex_unlock(&q->lock);
+}
+
+/* Gọi sau aio_set_closing(): chờ mọi yêu cầu bất đồng bộ đã nhận của file xong */
+void aio_drain(file_entry_t *file) {
+    aio_t *q = &g_cache.aio;
+
+    if (!q->running) {
+        return;
+    }
+
+    pthread_mutex_lock(&q->lock);
+    while (file->aio_pending > 0) {
+        pthread_cond_wait(&q->idle, &q->lock);
+    }
+    pthread_mutex_unlock(&q->lock);
+}
@@ -1,18 +1,26 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <stdbool.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <time.h>
 #include <sys/time.h>
 #include <sys/stat.h>
 
 #include "vtpc.h"
+#include "vtpc_internal.h"
 
 #define BENCH_FILE      "benchmark_data.tmp"
+#define BENCH_SPARSE_FILE "benchmark_sparse.tmp"
+#define BENCH_DIRTY_FILE "benchmark_dirty.tmp"
 #define FILE_SIZE       (64 * 1024 * 1024)  /* 64 MB */
 #define PAGE_SIZE       4096
 #define CACHE_PAGES     256                  /* 1 MB cache */
 #define NUM_RANDOM_OPS  10000
+#define LOOKUP_OPS      200000
 
 static long long get_time_us(void) {
     struct timeval tv;
@@ -20,6 +28,60 @@ static long long get_time_us(void) {
     return (long long)tv.tv_sec * 1000000LL + tv.tv_usec;
 }
 
+/* Thiết bị cho mọi lần init của vtpc, chọn bằng tham số dòng lệnh */
+static int bench_storage = VTPC_STORAGE_POSIX;
+static unsigned bench_latency_us = 0;
+static unsigned bench_bandwidth_mb = 0;
+
+static void bench_config_init(vtpc_config_t *config) {
+    vtpc_config_init(config);
+    config->storage = bench_storage;
+    config->storage_latency_us = bench_latency_us;
+    config->storage_bandwidth_mb = bench_bandwidth_mb;
+}
+
+static int bench_init(size_t cache_pages) {
+    vtpc_config_t config;
+
+    bench_config_init(&config);
+    config.cache_size_pages = cache_pages;
+    config.page_size = PAGE_SIZE;
+
+    return vtpc_init_ex(&config);
+}
+
+/*
+ * posix (mặc định) | memory | nvme | hdd | <latency_us>:<MB/s>
+ * Thiết bị giả lập chỉ áp dụng cho VTPC, cột "Direct I/O" vẫn đọc file thật.
+ * hdd chậm: các phép đọc ngẫu nhiên không locality mất vài phút.
+ */
+static int parse_storage(const char *arg) {
+    if (strcmp(arg, "posix") == 0) {
+        return 0;
+    }
+
+    bench_storage = VTPC_STORAGE_MEMORY;
+
+    if (strcmp(arg, "memory") == 0) {
+        return 0;
+    }
+    if (strcmp(arg, "nvme") == 0) {
+        bench_latency_us = 80;
+        bench_bandwidth_mb = 2000;
+        return 0;
+    }
+    if (strcmp(arg, "hdd") == 0) {
+        bench_latency_us = 4000;
+        bench_bandwidth_mb = 150;
+        return 0;
+    }
+    if (sscanf(arg, "%u:%u", &bench_latency_us, &bench_bandwidth_mb) == 2) {
+        return 0;
+    }
+
+    return -1;
+}
+
 /**
  * Tạo benchmark file
  */
@@ -167,6 +229,846 @@ static double bench_rand_read_vtpc(int num_ops, int max_pages) {
     return (double)(end - start) / 1000.0;
 }
 
+/**
+ * Tải trộn: đọc điểm ngẫu nhiên trong một tập nóng 768 page, cứ 2000 lần
+ * lại chen một lần quét tuần tự 2048 page. Cache 1024 page.
+ */
+static void bench_policy(int policy, const char *name) {
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    bench_config_init(&config);
+    config.cache_size_pages = 1024;
+    config.page_size = PAGE_SIZE;
+    config.policy = policy;
+
+    if (vtpc_init_ex(&config) < 0) {
+        perror("vtpc_init_ex");
+        return;
+    }
+
+    char *buf = malloc(PAGE_SIZE);
+    int fd = vtpc_open(BENCH_FILE);
+    off_t scan_pos = 4096;
+
+    vtpc_stats_t before, after;
+    size_t scan_hits = 0, scan_misses = 0;
+
+    srand(777);
+    long long start = get_time_us();
+
+    for (int i = 0; i < 40000; i++) {
+        if (i % 2000 == 1999) {
+            vtpc_get_stats(&before);
+            for (int j = 0; j < 2048; j++) {
+                vtpc_lseek(fd, scan_pos * PAGE_SIZE, SEEK_SET);
+                vtpc_read(fd, buf, PAGE_SIZE);
+                scan_pos = (scan_pos + 1 < FILE_SIZE / PAGE_SIZE) ? scan_pos + 1 : 4096;
+            }
+            vtpc_get_stats(&after);
+            scan_hits += after.cache_hits - before.cache_hits;
+            scan_misses += after.cache_misses - before.cache_misses;
+        }
+
+        /* Tập nóng lệch: nửa đầu được đọc nhiều gấp ba nửa sau */
+        off_t page = (rand() % 4 == 0) ? 384 + rand() % 384 : rand() % 384;
+        vtpc_lseek(fd, page * PAGE_SIZE, SEEK_SET);
+        vtpc_read(fd, buf, PAGE_SIZE);
+    }
+
+    long long end = get_time_us();
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    /* Hit rate riêng của tập nóng: bỏ phần hit/miss do các lần quét */
+    size_t hot_hits = stats.cache_hits - scan_hits;
+    size_t hot_misses = stats.cache_misses - scan_misses;
+
+    printf("  %-16s hit rate %6.2f%%, hot set %6.2f%%, %8.2f ms\n", name,
+           100.0 * stats.cache_hits / (stats.cache_hits + stats.cache_misses),
+           100.0 * hot_hits / (hot_hits + hot_misses),
+           (end - start) / 1000.0);
+
+    vtpc_close(fd);
+    free(buf);
+}
+
+/**
+ * Tập nóng 512 page trộn với đọc ngẫu nhiên không locality trên cả file
+ * (mỗi loại một nửa), cache 1024 page, có hoặc không có bộ lọc nhận
+ */
+static void bench_admission(int admission) {
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    bench_config_init(&config);
+    config.cache_size_pages = 1024;
+    config.page_size = PAGE_SIZE;
+    config.admission = admission;
+
+    if (vtpc_init_ex(&config) < 0) {
+        perror("vtpc_init_ex");
+        return;
+    }
+
+    char *buf = malloc(PAGE_SIZE);
+    int fd = vtpc_open(BENCH_FILE);
+    size_t hot_hits = 0, hot_total = 0;
+    vtpc_stats_t before, after;
+
+    srand(4242);
+    long long start = get_time_us();
+
+    for (int i = 0; i < 40000; i++) {
+        bool hot = rand() % 2 == 0;
+        off_t page = hot ? rand() % 512 : 512 + rand() % (FILE_SIZE / PAGE_SIZE - 512);
+
+        if (hot) {
+            vtpc_get_stats(&before);
+        }
+
+        vtpc_lseek(fd, page * PAGE_SIZE, SEEK_SET);
+        vtpc_read(fd, buf, PAGE_SIZE);
+
+        if (hot) {
+            vtpc_get_stats(&after);
+            hot_hits += after.cache_hits - before.cache_hits;
+            hot_total++;
+        }
+    }
+
+    long long end = get_time_us();
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    printf("  %-16s hit rate %6.2f%%, hot set %6.2f%%, %8.2f ms",
+           admission ? "W-TinyLFU" : "admit all",
+           100.0 * stats.cache_hits / (stats.cache_hits + stats.cache_misses),
+           100.0 * hot_hits / hot_total, (end - start) / 1000.0);
+    if (admission) {
+        printf(", sketch %zu KB, rejected %zu", stats.admission_sketch_bytes / 1024,
+               stats.admissions_rejected);
+    }
+    printf("\n");
+
+    vtpc_close(fd);
+    free(buf);
+}
+
+/**
+ * Đọc cả file bằng các lần đọc 1 MB vào buffer căn theo page, sau khi đã
+ * làm nóng 256 page; in thời gian quét và tỉ lệ hit khi đọc lại tập nóng.
+ */
+static void bench_bypass(size_t bypass_pages) {
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    bench_config_init(&config);
+    config.cache_size_pages = 1024;
+    config.page_size = PAGE_SIZE;
+    config.bypass_pages = bypass_pages;
+
+    if (vtpc_init_ex(&config) < 0) {
+        perror("vtpc_init_ex");
+        return;
+    }
+
+    const size_t chunk = 1024 * 1024;
+    void *big = NULL;
+    if (posix_memalign(&big, PAGE_SIZE, chunk) != 0) {
+        return;
+    }
+
+    int fd = vtpc_open(BENCH_FILE);
+
+    for (off_t p = 0; p < 256; p++) {
+        vtpc_lseek(fd, (p * 7 % 256) * PAGE_SIZE, SEEK_SET);
+        vtpc_read(fd, big, 64);
+    }
+
+    vtpc_lseek(fd, 0, SEEK_SET);
+    long long start = get_time_us();
+    while (vtpc_read(fd, big, chunk) > 0) {
+    }
+    long long end = get_time_us();
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+    size_t bypassed = stats.pages_bypassed;
+
+    vtpc_reset_stats();
+    for (off_t p = 0; p < 256; p++) {
+        vtpc_lseek(fd, (p * 7 % 256) * PAGE_SIZE, SEEK_SET);
+        vtpc_read(fd, big, 64);
+    }
+    vtpc_get_stats(&stats);
+
+    printf("  %-16s scan %8.2f ms (%5.0f MB/s), bypassed %6zu pages, hot set %6.2f%%\n",
+           bypass_pages ? "bypass >= 64" : "through cache",
+           (end - start) / 1000.0, (double)FILE_SIZE / (end - start),
+           bypassed, 100.0 * stats.cache_hits / 256);
+
+    vtpc_close(fd);
+    free(big);
+}
+
+/**
+ * Làm dirty toàn bộ cache 1024 page, nghỉ 300 ms (page dirty hết hạn sau
+ * 100 ms), rồi đọc 1024 page chưa có trong cache; in thời gian đọc và số
+ * page phải ghi trong lúc đọc.
+ */
+static void bench_dirty_reads(unsigned writeback_interval_ms) {
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    bench_config_init(&config);
+    config.cache_size_pages = 1024;
+    config.page_size = PAGE_SIZE;
+    config.readahead_pages = 0;
+    config.writeback_interval_ms = writeback_interval_ms;
+    config.dirty_expire_ms = 100;
+
+    if (vtpc_init_ex(&config) < 0) {
+        perror("vtpc_init_ex");
+        return;
+    }
+
+    char *buf = malloc(PAGE_SIZE);
+    memset(buf, 'd', PAGE_SIZE);
+
+    unlink(BENCH_DIRTY_FILE);
+    int wfd = vtpc_open(BENCH_DIRTY_FILE);
+    for (int i = 0; i < 1024; i++) {
+        vtpc_write(wfd, buf, PAGE_SIZE);
+    }
+    usleep(300 * 1000);
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+    size_t dirty = stats.dirty_pages;
+    vtpc_reset_stats();
+
+    int fd = vtpc_open(BENCH_FILE);
+    long long start = get_time_us();
+    for (int i = 0; i < 1024; i++) {
+        vtpc_lseek(fd, (off_t)i * 7 * PAGE_SIZE, SEEK_SET);
+        vtpc_read(fd, buf, PAGE_SIZE);
+    }
+    long long end = get_time_us();
+    vtpc_get_stats(&stats);
+
+    printf("  %-16s %8.2f ms (%5.1f us/miss), dirty before %4zu, written during reads %4zu\n",
+           writeback_interval_ms ? "flusher 100 ms" : "no flusher",
+           (end - start) / 1000.0, (double)(end - start) / 1024, dirty,
+           stats.pages_written_back - stats.pages_flushed_background);
+
+    vtpc_close(fd);
+    vtpc_close(wfd);
+    unlink(BENCH_DIRTY_FILE);
+    free(buf);
+}
+
+/**
+ * Làm dirty 1024 page của một file (liền nhau hoặc cách một page), không có
+ * luồng ghi ngầm, rồi fsync; in thời gian fsync, số yêu cầu ghi và số lần
+ * gửi qua io_uring.
+ */
+static void bench_fsync(int stride, int io_backend) {
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    bench_config_init(&config);
+    config.cache_size_pages = 4096;
+    config.page_size = PAGE_SIZE;
+    config.writeback_interval_ms = 0;
+    config.io_backend = io_backend;
+
+    if (vtpc_init_ex(&config) < 0) {
+        perror("vtpc_init_ex");
+        return;
+    }
+
+    char *buf = malloc(PAGE_SIZE);
+    memset(buf, 'f', PAGE_SIZE);
+
+    unlink(BENCH_DIRTY_FILE);
+    int fd = vtpc_open(BENCH_DIRTY_FILE);
+    for (int i = 0; i < 1024; i++) {
+        vtpc_lseek(fd, (off_t)i * stride * PAGE_SIZE, SEEK_SET);
+        vtpc_write(fd, buf, PAGE_SIZE);
+    }
+    vtpc_reset_stats();
+
+    long long start = get_time_us();
+    vtpc_fsync(fd);
+    long long end = get_time_us();
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    printf("  %-16s %-8s %8.2f ms, pages written %5zu, write requests %5zu, io_uring submits %4zu\n",
+           stride == 1 ? "contiguous" : "every other page",
+           stats.io_backend == VTPC_IO_URING ? "io_uring" : "sync",
+           (end - start) / 1000.0, stats.pages_written_back, stats.device_writes,
+           stats.uring_submits);
+
+    vtpc_close(fd);
+    unlink(BENCH_DIRTY_FILE);
+    free(buf);
+}
+
+/**
+ * Ghi đè 4 byte ở 1024 page 64 KB khác nhau (lệch dần trong page) rồi
+ * fsync; in thời gian fsync, số byte phải ghi và số byte tiết kiệm được.
+ */
+static void bench_small_writes(void) {
+    const size_t page_size = 65536;
+    const int pages = 1024;
+
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    bench_config_init(&config);
+    config.cache_size_pages = 2048;
+    config.page_size = page_size;
+    config.writeback_interval_ms = 0;
+    config.readahead_pages = 0;
+
+    if (vtpc_init_ex(&config) < 0) {
+        perror("vtpc_init_ex");
+        return;
+    }
+
+    unlink(BENCH_DIRTY_FILE);
+    int fd = vtpc_open(BENCH_DIRTY_FILE);
+    for (int i = 0; i < pages; i++) {
+        int value = i;
+        vtpc_lseek(fd, (off_t)i * (off_t)page_size + (off_t)(i * 4093 % page_size), SEEK_SET);
+        vtpc_write(fd, &value, sizeof(value));
+    }
+    vtpc_reset_stats();
+
+    long long start = get_time_us();
+    vtpc_fsync(fd);
+    long long end = get_time_us();
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    size_t total = (size_t)pages * page_size;
+    printf("  4-byte writes    %8.2f ms, bytes written %8zu of %8zu, saved %5.1f%%, write calls %4zu\n",
+           (end - start) / 1000.0, total - stats.write_bytes_saved, total,
+           100.0 * stats.write_bytes_saved / total, stats.device_writes);
+
+    vtpc_close(fd);
+    unlink(BENCH_DIRTY_FILE);
+}
+
+/**
+ * Đọc cả file bằng các lần đọc 64 KB lệch 512 byte so với page (mỗi lần
+ * chạm 17 page, không đi thẳng xuống thiết bị được), không đọc trước; in
+ * thời gian và số lời gọi đọc xuống thiết bị cho mỗi lần vtpc_read.
+ */
+static void bench_multi_page_read(void) {
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    bench_config_init(&config);
+    config.cache_size_pages = 1024;
+    config.page_size = PAGE_SIZE;
+    config.readahead_pages = 0;
+
+    if (vtpc_init_ex(&config) < 0) {
+        perror("vtpc_init_ex");
+        return;
+    }
+
+    const size_t chunk = 64 * 1024;
+    char *buf = malloc(chunk);
+    int fd = vtpc_open(BENCH_FILE);
+    size_t calls = 0;
+
+    vtpc_lseek(fd, 512, SEEK_SET);
+    long long start = get_time_us();
+    while (vtpc_read(fd, buf, chunk) > 0) {
+        calls++;
+    }
+    long long end = get_time_us();
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    printf("  64 KB reads      %8.2f ms (%5.0f MB/s), %5.2f device reads per call\n",
+           (end - start) / 1000.0, (double)FILE_SIZE / (end - start),
+           (double)stats.device_reads / calls);
+
+    vtpc_close(fd);
+    free(buf);
+}
+
+/**
+ * Đọc tuần tự cả file từng page 4K, mỗi page được cộng checksum như một
+ * người đọc đang xử lý dữ liệu; in thời gian và số page đọc trước.
+ */
+static void bench_readahead(size_t readahead_pages) {
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    bench_config_init(&config);
+    config.cache_size_pages = 1024;
+    config.page_size = PAGE_SIZE;
+    config.readahead_pages = readahead_pages;
+
+    if (vtpc_init_ex(&config) < 0) {
+        perror("vtpc_init_ex");
+        return;
+    }
+
+    unsigned char *buf = malloc(PAGE_SIZE);
+    int fd = vtpc_open(BENCH_FILE);
+    unsigned long sum = 0;
+
+    long long start = get_time_us();
+    while (vtpc_read(fd, buf, PAGE_SIZE) > 0) {
+        for (int i = 0; i < PAGE_SIZE; i++) {
+            sum += buf[i];
+        }
+    }
+    long long end = get_time_us();
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    printf("  %-16s %8.2f ms (%5.0f MB/s), misses %6zu, prefetched %6zu, wasted %4zu%s\n",
+           readahead_pages ? "readahead <= 64" : "no readahead",
+           (end - start) / 1000.0, (double)FILE_SIZE / (end - start),
+           stats.cache_misses, stats.pages_prefetched, stats.prefetch_wasted,
+           sum == 0 ? " (empty)" : "");
+
+    vtpc_close(fd);
+    free(buf);
+}
+
+/**
+ * 2048 lần đọc 4K ngẫu nhiên không locality (hầu hết là miss): vtpc_read()
+ * từng lần một, hoặc luôn giữ depth yêu cầu bất đồng bộ và chờ hoàn tất
+ * qua eventfd như một event loop.
+ */
+static void bench_async(int depth) {
+    const int ops = 2048;
+
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    bench_config_init(&config);
+    config.cache_size_pages = 1024;
+    config.page_size = PAGE_SIZE;
+    config.readahead_pages = 0;
+
+    if (vtpc_init_ex(&config) < 0) {
+        perror("vtpc_init_ex");
+        return;
+    }
+
+    int fd = vtpc_open(BENCH_FILE);
+    int efd = vtpc_aio_fd();
+    int slots = (depth > 0) ? depth : 1;
+    char *bufs = malloc((size_t)slots * PAGE_SIZE);
+    vtpc_aio_t *reqs = calloc((size_t)slots, sizeof(vtpc_aio_t));
+    vtpc_aio_t **done = malloc((size_t)slots * sizeof(vtpc_aio_t *));
+    int *free_slots = malloc((size_t)slots * sizeof(int));
+    off_t *offsets = malloc(ops * sizeof(off_t));
+
+    srand(4242);
+    for (int i = 0; i < ops; i++) {
+        offsets[i] = (off_t)(rand() % (FILE_SIZE / PAGE_SIZE)) * PAGE_SIZE;
+    }
+    for (int i = 0; i < slots; i++) {
+        free_slots[i] = i;
+    }
+
+    long long start = get_time_us();
+
+    if (depth == 0) {
+        for (int i = 0; i < ops; i++) {
+            vtpc_lseek(fd, offsets[i], SEEK_SET);
+            vtpc_read(fd, bufs, PAGE_SIZE);
+        }
+    } else {
+        int submitted = 0, completed = 0, nfree = slots;
+
+        while (completed < ops) {
+            while (nfree > 0 && submitted < ops) {
+                int slot = free_slots[--nfree];
+                vtpc_aio_t *aio = &reqs[slot];
+
+                aio->fd = fd;
+                aio->buf = bufs + (size_t)slot * PAGE_SIZE;
+                aio->count = PAGE_SIZE;
+                aio->offset = offsets[submitted++];
+                if (vtpc_read_async(aio) != 1) {
+                    free_slots[nfree++] = slot;
+                    completed++;
+                }
+            }
+
+            uint64_t events;
+            if (completed < ops && read(efd, &events, sizeof(events)) < 0) {
+                struct pollfd pfd = { .fd = efd, .events = POLLIN };
+                poll(&pfd, 1, -1);
+            }
+
+            size_t n = vtpc_aio_reap(done, (size_t)slots);
+            for (size_t i = 0; i < n; i++) {
+                free_slots[nfree++] = (int)(done[i] - reqs);
+                completed++;
+            }
+        }
+    }
+
+    long long end = get_time_us();
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    char label[32];
+    snprintf(label, sizeof(label), depth ? "async, depth %d" : "vtpc_read", depth);
+    printf("  %-16s %8.2f ms (%6.1f us/op), misses %5zu, completed inline %4zu\n",
+           label, (end - start) / 1000.0, (double)(end - start) / ops,
+           stats.cache_misses, stats.aio_completed_inline);
+
+    vtpc_close(fd);
+    free(offsets);
+    free(free_slots);
+    free(done);
+    free(reqs);
+    free(bufs);
+}
+
+/**
+ * Parser chỉ đọc byte: 1024 page đầu của file (đã nằm trong cache 2048
+ * page) được duyệt 20 lượt, chép ra bằng vtpc_read() hoặc xem tại chỗ qua
+ * vtpc_pin()/vtpc_unpin().
+ */
+static void bench_pin(int pin) {
+    const int pages = 1024;
+    const int passes = 20;
+
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    bench_config_init(&config);
+    config.cache_size_pages = 2048;
+    config.page_size = PAGE_SIZE;
+    config.readahead_pages = 0;
+
+    if (vtpc_init_ex(&config) < 0) {
+        perror("vtpc_init_ex");
+        return;
+    }
+
+    unsigned char *buf = malloc(PAGE_SIZE);
+    int fd = vtpc_open(BENCH_FILE);
+    unsigned long sum = 0;
+
+    for (int i = 0; i < pages; i++) {
+        vtpc_read(fd, buf, PAGE_SIZE);
+    }
+
+    long long start = get_time_us();
+
+    for (int pass = 0; pass < passes; pass++) {
+        for (int i = 0; i < pages; i++) {
+            off_t offset = (off_t)i * PAGE_SIZE;
+
+            if (pin) {
+                unsigned char *ptr;
+                size_t len;
+                int handle = vtpc_pin(fd, offset, (void **)&ptr, &len);
+
+                for (size_t j = 0; j < len; j += 64) {
+                    sum += ptr[j];
+                }
+                vtpc_unpin(handle, 0);
+            } else {
+                vtpc_lseek(fd, offset, SEEK_SET);
+                ssize_t len = vtpc_read(fd, buf, PAGE_SIZE);
+
+                for (ssize_t j = 0; j < len; j += 64) {
+                    sum += buf[j];
+                }
+            }
+        }
+    }
+
+    long long end = get_time_us();
+
+    printf("  %-16s %8.2f ms (%5.0f ns/page)%s\n",
+           pin ? "vtpc_pin" : "vtpc_read", (end - start) / 1000.0,
+           (double)(end - start) * 1000.0 / (pages * passes), sum == 0 ? " (empty)" : "");
+
+    vtpc_close(fd);
+    free(buf);
+}
+
+/**
+ * Chi phí riêng của choose_victim: gọi thẳng policy trên một shard của cache
+ * rỗng, không qua đường đọc hay thiết bị. Hot set bằng 90% shard được hit
+ * vòng liên tục (reference bit luôn bật), cứ 32 lần hit thì chọn một victim,
+ * gỡ nó và nạp lại vào chỗ đó như một page mới. Chỉ thời gian của
+ * choose_victim được tính, nửa đầu các lần chọn để ổn định trạng thái.
+ */
+static void bench_victim_cost(int policy, const char *name) {
+    const size_t rounds = 65536;
+    const size_t hits_per_victim = 32;
+
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 65536;
+    config.page_size = PAGE_SIZE;
+    config.policy = policy;
+    config.reclaim_low_ratio = 0;
+    config.storage = VTPC_STORAGE_MEMORY;
+
+    vtpc_destroy();
+    if (vtpc_init_ex(&config) < 0) {
+        perror("vtpc_init_ex");
+        return;
+    }
+
+    cache_shard_t *shard = &g_cache.shards[0];
+    const cache_policy_t *pol = g_cache.policy;
+    size_t hot_pages = shard->page_count * 9 / 10;
+    size_t next_hot = 0;
+    long long victim_ns = 0;
+    size_t victims = 0;
+
+    pthread_mutex_lock(&shard->lock);
+
+    for (size_t i = 0; i < shard->page_count; i++) {
+        pol->on_insert(shard, shard->first_page + (page_id_t)i, false);
+    }
+
+    for (size_t r = 0; r < rounds; r++) {
+        struct timespec start, end;
+
+        for (size_t h = 0; h < hits_per_victim; h++) {
+            pol->on_hit(shard, shard->first_page + (page_id_t)next_hot);
+            next_hot = (next_hot + 1) % hot_pages;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        page_id_t victim = pol->choose_victim(shard);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        if (victim == PAGE_NONE) {
+            break;
+        }
+        pol->on_remove(shard, victim, true);
+        pol->on_insert(shard, victim, false);
+
+        if (r >= rounds / 2) {
+            victim_ns += (end.tv_sec - start.tv_sec) * 1000000000LL +
+                         (end.tv_nsec - start.tv_nsec);
+            victims++;
+        }
+    }
+
+    for (size_t i = 0; i < shard->page_count; i++) {
+        pol->on_remove(shard, shard->first_page + (page_id_t)i, false);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    printf("  %-14s %8.1f ns/victim (%zu-page shard)\n", name,
+           victims ? (double)victim_ns / (double)victims : 0.0, shard->page_count);
+
+    vtpc_destroy();
+}
+
+static int cmp_latency(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Đọc ngẫu nhiên kéo dài trên cache 65536 page: 90% lần đọc rơi vào hot set
+ * bằng 90% cache, còn lại là page lạnh ngẫu nhiên trong một file thưa lớn
+ * gấp 8 lần. In p50/p99 thời gian một lần miss sau khi cache đã đầy và số
+ * miss phải tự tìm victim.
+ */
+static void bench_reclaim(unsigned reclaim_low_ratio) {
+    const off_t cache_pages = 65536;
+    const off_t hot_pages = cache_pages * 9 / 10;
+    const off_t file_pages = cache_pages * 8;
+    const int ops = 400000;
+
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    bench_config_init(&config);
+    config.cache_size_pages = (size_t)cache_pages;
+    config.page_size = PAGE_SIZE;
+    config.readahead_pages = 0;
+    config.reclaim_low_ratio = reclaim_low_ratio;
+
+    if (vtpc_init_ex(&config) < 0) {
+        perror("vtpc_init_ex");
+        return;
+    }
+    vtpc_set_direct_mode(0);
+
+    int sfd = open(BENCH_SPARSE_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (sfd < 0 || ftruncate(sfd, file_pages * PAGE_SIZE) < 0) {
+        perror("sparse file");
+        if (sfd >= 0) {
+            close(sfd);
+        }
+        return;
+    }
+    close(sfd);
+
+    char *buf = malloc(PAGE_SIZE);
+    long long *lat = malloc(ops * sizeof(*lat));
+    size_t misses = 0;
+    int fd = vtpc_open(BENCH_SPARSE_FILE);
+
+    /* Lấp đầy cache bằng hot set và page lạnh trước khi đo */
+    for (off_t p = 0; p < cache_pages; p++) {
+        vtpc_lseek(fd, p * PAGE_SIZE, SEEK_SET);
+        vtpc_read(fd, buf, 64);
+    }
+    vtpc_reset_stats();
+
+    srand(4242);
+    for (int i = 0; i < ops; i++) {
+        if (i % 10 != 0) {
+            vtpc_lseek(fd, (off_t)(rand() % hot_pages) * PAGE_SIZE, SEEK_SET);
+            vtpc_read(fd, buf, 64);
+            continue;
+        }
+
+        off_t cold = hot_pages + (off_t)rand() % (file_pages - hot_pages);
+        vtpc_lseek(fd, cold * PAGE_SIZE, SEEK_SET);
+        long long start = get_time_us();
+        vtpc_read(fd, buf, 64);
+        lat[misses++] = get_time_us() - start;
+    }
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+    qsort(lat, misses, sizeof(*lat), cmp_latency);
+
+    printf("  %-16s p50 %4lld us, p99 %4lld us, direct evictions %6zu, reclaimed %6zu\n",
+           reclaim_low_ratio ? "reclaim 2%" : "no reclaim",
+           lat[misses / 2], lat[misses * 99 / 100],
+           stats.direct_evictions, stats.pages_reclaimed);
+
+    vtpc_close(fd);
+    free(lat);
+    free(buf);
+    vtpc_destroy();
+    unlink(BENCH_SPARSE_FILE);
+}
+
+/* RSS hiện tại của tiến trình, theo KB */
+static size_t rss_kb(void) {
+    long pages_total = 0, pages_resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+
+    if (f == NULL) {
+        return 0;
+    }
+    if (fscanf(f, "%ld %ld", &pages_total, &pages_resident) != 2) {
+        pages_resident = 0;
+    }
+    fclose(f);
+
+    return (size_t)pages_resident * (size_t)sysconf(_SC_PAGESIZE) / 1024;
+}
+
+/**
+ * Thời gian vtpc_init và RSS tăng thêm với cache rất lớn: page chỉ được
+ * cấp RAM khi dùng tới, nên RSS theo số page đã đọc chứ không theo cache_size
+ */
+static void bench_startup(size_t cache_pages) {
+    vtpc_destroy();
+
+    size_t rss_before = rss_kb();
+    long long start = get_time_us();
+
+    if (bench_init(cache_pages) < 0) {
+        perror("vtpc_init");
+        return;
+    }
+
+    long long end = get_time_us();
+    size_t rss_init = rss_kb();
+
+    char *buf = malloc(PAGE_SIZE);
+    int fd = vtpc_open(BENCH_FILE);
+    for (int i = 0; i < 4096; i++) {
+        vtpc_read(fd, buf, PAGE_SIZE);
+    }
+    vtpc_close(fd);
+    free(buf);
+
+    printf("  %8zu pages (%5zu MB): init %8.2f ms, RSS +%6zu KB, after 4096 reads +%6zu KB\n",
+           cache_pages, cache_pages * PAGE_SIZE / (1024 * 1024),
+           (end - start) / 1000.0, rss_init - rss_before, rss_kb() - rss_before);
+}
+
+/**
+ * Chi phí một lần hit: đọc 64 byte ngẫu nhiên trong một tập page đã nằm
+ * trong cache, để thấy chi phí lookup khi cache lớn dần
+ */
+static double bench_lookup_cost(int cache_pages) {
+    vtpc_destroy();
+    if (bench_init(cache_pages) < 0) {
+        perror("vtpc_init");
+        return -1;
+    }
+
+    char *buf = malloc(PAGE_SIZE);
+
+    int fd = vtpc_open(BENCH_FILE);
+    if (fd < 0) {
+        perror("vtpc_open");
+        free(buf);
+        return -1;
+    }
+
+    /* Chỉ nạp nửa cache để shard nào cũng còn chỗ, mọi lần đo đều là hit */
+    int resident = cache_pages / 2;
+    for (int i = 0; i < resident; i++) {
+        vtpc_read(fd, buf, PAGE_SIZE);
+    }
+
+    off_t *offsets = malloc(LOOKUP_OPS * sizeof(off_t));
+    srand(12345);
+    for (int i = 0; i < LOOKUP_OPS; i++) {
+        offsets[i] = (off_t)(rand() % resident) * PAGE_SIZE + (rand() % 64) * 64;
+    }
+
+    long long start = get_time_us();
+
+    for (int i = 0; i < LOOKUP_OPS; i++) {
+        vtpc_lseek(fd, offsets[i], SEEK_SET);
+        vtpc_read(fd, buf, 64);
+    }
+
+    long long end = get_time_us();
+
+    vtpc_close(fd);
+    free(buf);
+    free(offsets);
+
+    return (double)(end - start) * 1000.0 / LOOKUP_OPS;
+}
+
 static void print_result(const char *name, double direct_ms, double vtpc_ms) {
     double speedup = direct_ms / vtpc_ms;
 
@@ -179,18 +1081,28 @@ static void print_result(const char *name, double direct_ms, double vtpc_ms) {
     }
 }
 
-int main(void) {
+int main(int argc, char **argv) {
+    if (argc > 1 && parse_storage(argv[1]) < 0) {
+        fprintf(stderr, "usage: %s [posix|memory|nvme|hdd|<latency_us>:<MB/s>]\n", argv[0]);
+        return 1;
+    }
+
     printf("\n");
 
     printf("File size:   %d MB\n", FILE_SIZE / (1024 * 1024));
     printf("Page size:   %d bytes\n", PAGE_SIZE);
     printf("Cache size:  %d pages (%d KB)\n", CACHE_PAGES, CACHE_PAGES * PAGE_SIZE / 1024);
+    if (bench_storage == VTPC_STORAGE_MEMORY) {
+        printf("Storage:     memory (%u us/IO, %u MB/s)\n", bench_latency_us, bench_bandwidth_mb);
+    } else {
+        printf("Storage:     posix\n");
+    }
     printf("========================================================\n\n");
 
     create_bench_file();
 
     vtpc_destroy();
-    if (vtpc_init(CACHE_PAGES, PAGE_SIZE) < 0) {
+    if (bench_init(CACHE_PAGES) < 0) {
         perror("vtpc_init");
         return 1;
     }
@@ -236,6 +1148,85 @@ int main(void) {
            100.0 * stats.cache_hits / (stats.cache_hits + stats.cache_misses));
     printf("  Pages evicted:    %zu\n", stats.pages_evicted);
     printf("  Pages written:    %zu\n", stats.pages_written_back);
+    printf("  Metadata:         %zu bytes (%zu bytes/page)\n",
+           stats.metadata_bytes, stats.metadata_bytes_per_page);
+    printf("  Arena:            %zu KB (%s)\n", stats.arena_bytes / 1024,
+           stats.arena_backing == VTPC_BACKING_HUGETLB ? "hugetlb" :
+           stats.arena_backing == VTPC_BACKING_THP ? "THP" : "4K pages");
+    printf("\n");
+
+    printf("Hash lookup cost (random 64-byte hits):\n");
+    for (int pages = 1024; pages <= FILE_SIZE / PAGE_SIZE; pages *= 4) {
+        printf("  %6d pages:     %8.1f ns/op\n", pages, bench_lookup_cost(pages));
+    }
+    printf("\n");
+
+    printf("Replacement policy (mixed point reads + scans, 1024-page cache):\n");
+    bench_policy(VTPC_POLICY_SECOND_CHANCE, "Second Chance");
+    bench_policy(VTPC_POLICY_ARC, "ARC");
+    bench_policy(VTPC_POLICY_S3FIFO, "S3-FIFO");
+    printf("\n");
+
+    printf("Victim selection (one shard of a 65536-page cache, 90%% hot set):\n");
+    bench_victim_cost(VTPC_POLICY_SECOND_CHANCE, "Second Chance");
+    bench_victim_cost(VTPC_POLICY_ARC, "ARC");
+    bench_victim_cost(VTPC_POLICY_S3FIFO, "S3-FIFO");
+    printf("\n");
+
+    printf("Miss latency under sustained random reads (65536-page cache, 90%% hot set):\n");
+    bench_reclaim(0);
+    bench_reclaim(2);
+    printf("\n");
+
+    printf("Admission filter (hot set + reads without locality, 1024-page cache):\n");
+    bench_admission(0);
+    bench_admission(1);
+    printf("\n");
+
+    printf("Large aligned reads (1 MB chunks over the file, 1024-page cache):\n");
+    bench_bypass(0);
+    bench_bypass(64);
+    printf("\n");
+
+    printf("Read misses after filling the cache with dirty pages (1024-page cache):\n");
+    bench_dirty_reads(0);
+    bench_dirty_reads(100);
+    printf("\n");
+
+    printf("fsync of 1024 dirty pages (4096-page cache, no flusher):\n");
+    bench_fsync(1, VTPC_IO_SYNC);
+    bench_fsync(2, VTPC_IO_SYNC);
+    bench_fsync(2, VTPC_IO_AUTO);
+    printf("\n");
+
+    printf("Small overwrites on 64 KB pages (fsync of 1024 pages):\n");
+    bench_small_writes();
+    printf("\n");
+
+    printf("Unaligned multi-page reads (1024-page cache, no readahead):\n");
+    bench_multi_page_read();
+    printf("\n");
+
+    printf("Sequential 4K reads with per-page work (1024-page cache):\n");
+    bench_readahead(0);
+    bench_readahead(64);
+    printf("\n");
+
+    printf("Random 4K misses from one thread (1024-page cache, no readahead):\n");
+    bench_async(0);
+    bench_async(8);
+    bench_async(64);
+    printf("\n");
+
+    printf("Scanning cached pages, one byte per cache line (2048-page cache):\n");
+    bench_pin(0);
+    bench_pin(1);
+    printf("\n");
+
+    printf("Startup cost (lazy page materialization):\n");
+    for (size_t pages = 16384; pages <= 4194304; pages *= 16) {
+        bench_startup(pages);
+    }
     printf("\n");
 
     vtpc_destroy();
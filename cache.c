@@ -3,23 +3,142 @@
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "vtpc_internal.h"
 
 cache_state_t g_cache = { .initialized = false };
 
+/* Lookaside L0 theo thread: key -> page + generation */
+typedef struct {
+    unsigned long instance;
+    uint64_t key;
+    page_id_t page;
+    unsigned int generation;
+} lookaside_entry_t;
+
+static _Thread_local lookaside_entry_t tls_lookaside[VTPC_L0_ENTRIES];
+
+static lookaside_entry_t *lookaside_slot(uint64_t key) {
+    return &tls_lookaside[(key ^ (key >> 56) * 31) % VTPC_L0_ENTRIES];
+}
+
+/*
+ * O(1) theo kích thước cache: mảng mô tả lấy từ calloc (vùng lớn được kernel
+ * cấp page 0 khi chạm tới lần đầu) và arena không bị ghi trước. Page chưa
+ * từng dùng được cấp dần qua fresh_next của shard.
+ */
+int cache_pages_init(bool huge_pages, bool lock_memory) {
+    size_t n = g_cache.cache_size;
+
+    g_cache.sector_size = VTPC_SECTOR_SIZE;
+    while ((g_cache.page_size + g_cache.sector_size - 1) / g_cache.sector_size > VTPC_SECTOR_WORDS * 64) {
+        g_cache.sector_size *= 2;
+    }
+    g_cache.sectors_per_page = (g_cache.page_size + g_cache.sector_size - 1) / g_cache.sector_size;
+    g_cache.sector_words = (g_cache.sectors_per_page + 63) / 64;
+
+    g_cache.page_keys = calloc(n, sizeof(uint64_t));
+    g_cache.page_flags = calloc(n, sizeof(atomic_uint));
+    g_cache.page_seq = calloc(n, sizeof(atomic_uint));
+    g_cache.page_generation = calloc(n, sizeof(atomic_uint));
+    g_cache.page_refcount = calloc(n, sizeof(atomic_uint));
+    g_cache.page_links = calloc(n, sizeof(page_link_t));
+    g_cache.page_dirtied = calloc(n, sizeof(uint32_t));
+    g_cache.page_dirty_links = calloc(n, sizeof(page_link_t));
+    g_cache.page_sectors = calloc(n * g_cache.sector_words, sizeof(uint64_t));
+    g_cache.arena = arena_map(n * g_cache.page_size, huge_pages,
+                              &g_cache.arena_mapped, &g_cache.arena_backing);
+
+    if (g_cache.page_keys == NULL || g_cache.page_flags == NULL ||
+        g_cache.page_seq == NULL || g_cache.page_generation == NULL ||
+        g_cache.page_refcount == NULL || g_cache.page_links == NULL ||
+        g_cache.page_dirtied == NULL || g_cache.page_dirty_links == NULL ||
+        g_cache.page_sectors == NULL || g_cache.arena == NULL) {
+        cache_pages_destroy();
+        errno = ENOMEM;
+        return -1;
+    }
+
+    /* Khóa arena trong RAM để page cache không bao giờ bị swap (nạp trước toàn bộ) */
+    if (lock_memory) {
+        if (mlock(g_cache.arena, g_cache.arena_mapped) < 0) {
+            int saved_errno = errno;
+            cache_pages_destroy();
+            errno = saved_errno;
+            return -1;
+        }
+        g_cache.arena_locked = true;
+    }
+
+    return 0;
+}
+
+void cache_pages_destroy(void) {
+    if (g_cache.arena_locked) {
+        munlock(g_cache.arena, g_cache.arena_mapped);
+        g_cache.arena_locked = false;
+    }
+    arena_unmap(g_cache.arena, g_cache.arena_mapped);
+
+    free(g_cache.page_keys);
+    free(g_cache.page_flags);
+    free(g_cache.page_seq);
+    free(g_cache.page_generation);
+    free(g_cache.page_refcount);
+    free(g_cache.page_links);
+    free(g_cache.page_dirtied);
+    free(g_cache.page_dirty_links);
+    free(g_cache.page_sectors);
+
+    g_cache.page_keys = NULL;
+    g_cache.page_flags = NULL;
+    g_cache.page_seq = NULL;
+    g_cache.page_generation = NULL;
+    g_cache.page_refcount = NULL;
+    g_cache.page_links = NULL;
+    g_cache.page_dirtied = NULL;
+    g_cache.page_dirty_links = NULL;
+    g_cache.page_sectors = NULL;
+    g_cache.arena = NULL;
+    g_cache.arena_mapped = 0;
+}
+
+/* Bộ nhớ metadata (không tính dữ liệu page): mô tả page và bảng hash */
+size_t cache_metadata_bytes(void) {
+    size_t per_page = sizeof(uint64_t) + 4 * sizeof(atomic_uint) + 2 * sizeof(page_link_t) +
+                      sizeof(uint32_t) + g_cache.sector_words * sizeof(uint64_t);
+    size_t bytes = g_cache.cache_size * per_page;
+
+    for (size_t s = 0; s < g_cache.num_shards; s++) {
+        cache_shard_t *shard = &g_cache.shards[s];
+
+        pthread_mutex_lock(&shard->lock);
+        bytes += shard->hash_table->capacity * (sizeof(uint8_t) + sizeof(page_id_t));
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return bytes;
+}
+
 void queue_init(page_queue_t *q) {
-    q->head = NULL;
-    q->tail = NULL;
+    q->head = PAGE_NONE;
+    q->tail = PAGE_NONE;
     q->count = 0;
 }
 
-void queue_push_back(page_queue_t *q, cache_page_t *page) {
-    page->queue_next = NULL;
-    page->queue_prev = q->tail;
+void queue_push_back(page_queue_t *q, page_id_t page) {
+    page_link_t *links = g_cache.page_links;
 
-    if (q->tail != NULL) {
-        q->tail->queue_next = page;
+    links[page].next = PAGE_NONE;
+    links[page].prev = q->tail;
+
+    if (q->tail != PAGE_NONE) {
+        links[q->tail].next = page;
     } else {
         /* Queue rỗng */
         q->head = page;
@@ -29,46 +148,65 @@ void queue_push_back(page_queue_t *q, cache_page_t *page) {
     q->count++;
 }
 
-cache_page_t *queue_pop_front(page_queue_t *q) {
-    if (q->head == NULL) {
-        return NULL;
+void queue_push_front(page_queue_t *q, page_id_t page) {
+    page_link_t *links = g_cache.page_links;
+
+    links[page].prev = PAGE_NONE;
+    links[page].next = q->head;
+
+    if (q->head != PAGE_NONE) {
+        links[q->head].prev = page;
+    } else {
+        q->tail = page;
+    }
+
+    q->head = page;
+    q->count++;
+}
+
+page_id_t queue_pop_front(page_queue_t *q) {
+    if (q->head == PAGE_NONE) {
+        return PAGE_NONE;
     }
 
-    cache_page_t *page = q->head;
+    page_link_t *links = g_cache.page_links;
+    page_id_t page = q->head;
 
-    q->head = page->queue_next;
-    if (q->head != NULL) {
-        q->head->queue_prev = NULL;
+    q->head = links[page].next;
+    if (q->head != PAGE_NONE) {
+        links[q->head].prev = PAGE_NONE;
     } else {
-        q->tail = NULL;
+        q->tail = PAGE_NONE;
     }
 
-    page->queue_next = NULL;
-    page->queue_prev = NULL;
+    links[page].next = PAGE_NONE;
+    links[page].prev = PAGE_NONE;
     q->count--;
 
     return page;
 }
 
-void queue_remove(page_queue_t *q, cache_page_t *page) {
-    if (page->queue_prev != NULL) {
-        page->queue_prev->queue_next = page->queue_next;
+void queue_remove(page_queue_t *q, page_id_t page) {
+    page_link_t *links = g_cache.page_links;
+
+    if (links[page].prev != PAGE_NONE) {
+        links[links[page].prev].next = links[page].next;
     } else {
-        q->head = page->queue_next;
+        q->head = links[page].next;
     }
 
-    if (page->queue_next != NULL) {
-        page->queue_next->queue_prev = page->queue_prev;
+    if (links[page].next != PAGE_NONE) {
+        links[links[page].next].prev = links[page].prev;
     } else {
-        q->tail = page->queue_prev;
+        q->tail = links[page].prev;
     }
 
-    page->queue_next = NULL;
-    page->queue_prev = NULL;
+    links[page].next = PAGE_NONE;
+    links[page].prev = PAGE_NONE;
     q->count--;
 }
 
-void queue_move_to_back(page_queue_t *q, cache_page_t *page) {
+void queue_move_to_back(page_queue_t *q, page_id_t page) {
     if (page == q->tail) {
         return;
     }
@@ -78,229 +216,1543 @@ void queue_move_to_back(page_queue_t *q, cache_page_t *page) {
     queue_push_back(q, page);
 }
 
-uint32_t hash_function(int fd, off_t block_num) {
-    uint64_t key = ((uint64_t)fd << 32) | (uint64_t)(block_num & 0xFFFFFFFF);
-
+uint64_t hash_key(uint64_t key) {
     key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
     key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
     key = key ^ (key >> 31);
 
-    return (uint32_t)(key % HASH_TABLE_SIZE);
+    return key;
 }
 
-void hash_insert(cache_page_t *page) {
-    uint32_t idx = hash_function(page->fd, page->block_num);
+uint64_t hash_function(int fd, off_t block_num) {
+    return hash_key(page_key(fd, block_num));
+}
 
-    page->hash_next = g_cache.hash_table.buckets[idx];
-    g_cache.hash_table.buckets[idx] = page;
+cache_shard_t *cache_shard_of(int fd, off_t block_num) {
+    return &g_cache.shards[hash_function(fd, block_num) & (g_cache.num_shards - 1)];
 }
 
-void hash_remove(cache_page_t *page) {
-    uint32_t idx = hash_function(page->fd, page->block_num);
-    cache_page_t **pp = &g_cache.hash_table.buckets[idx];
+cache_shard_t *cache_page_shard(page_id_t page) {
+    size_t idx = page / g_cache.pages_per_shard;
 
-    while (*pp != NULL) {
-        if (*pp == page) {
-            *pp = page->hash_next;
-            page->hash_next = NULL;
-            return;
-        }
-        pp = &(*pp)->hash_next;
+    if (idx >= g_cache.num_shards) {
+        idx = g_cache.num_shards - 1;
     }
+
+    return &g_cache.shards[idx];
 }
 
-cache_page_t *hash_lookup(int fd, off_t block_num) {
-    uint32_t idx = hash_function(fd, block_num);
-    cache_page_t *page = g_cache.hash_table.buckets[idx];
+static uint8_t hash_tag(uint64_t h) {
+    return (uint8_t)(0x80 | (h >> 57));
+}
 
-    while (page != NULL) {
-        if (page->fd == fd && page->block_num == block_num && page->valid) {
-            return page;
+static size_t hash_group(const page_hash_table_t *table, uint64_t h) {
+    /* Các bit thấp đã dùng để chọn shard */
+    return (size_t)(h >> 8) & table->group_mask;
+}
+
+static uint32_t group_match(const uint8_t *tags, uint8_t tag) {
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i *)tags);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)tag)));
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < HASH_GROUP_SIZE; i++) {
+        if (tags[i] == tag) {
+            mask |= 1u << i;
         }
-        page = page->hash_next;
     }
-
-    return NULL;
+    return mask;
+#endif
 }
 
-int cache_flush_page(cache_page_t *page) {
-    /* Không cần flush nếu không dirty */
-    if (!page->valid || !page->dirty) {
-        return 0;
+static page_hash_table_t *table_create(size_t capacity) {
+    page_hash_table_t *table = malloc(sizeof(page_hash_table_t));
+    if (table == NULL) {
+        return NULL;
     }
 
-    file_entry_t *file = get_file_entry(page->fd);
-    if (file == NULL || !file->in_use) {
-        errno = EBADF;
-        return -1;
+    table->capacity = capacity;
+    table->group_mask = capacity / HASH_GROUP_SIZE - 1;
+    table->used = 0;
+    table->tombstones = 0;
+    /* Tag EMPTY là 0; slot chỉ được đọc khi tag khớp nên không cần khởi tạo */
+    table->tags = calloc(capacity, 1);
+    table->slots = calloc(capacity, sizeof(page_id_t));
+
+    if (table->tags == NULL || table->slots == NULL) {
+        free(table->tags);
+        free(table->slots);
+        free(table);
+        return NULL;
     }
 
-    ssize_t written = direct_write_block(
-        file->real_fd,
-        page->block_num,
-        page->data,
-        g_cache.page_size
-    );
+    return table;
+}
 
-    if (written < 0) {
-        return -1;
+static void table_free(page_hash_table_t *table) {
+    if (table == NULL) {
+        return;
     }
 
-    page->dirty = false;
-    g_cache.pages_written_back++;
+    free(table->tags);
+    free(table->slots);
+    free(table);
+}
 
-    return 0;
+/* Key đã biết là chưa có trong bảng; dùng slot EMPTY/DELETED đầu tiên */
+static void table_insert(page_hash_table_t *table, page_id_t page, uint64_t h) {
+    size_t g = hash_group(table, h);
+
+    for (size_t step = 0; step <= table->group_mask; step++) {
+        uint8_t *tags = &table->tags[g * HASH_GROUP_SIZE];
+        uint32_t free_mask = group_match(tags, HASH_TAG_EMPTY) |
+                             group_match(tags, HASH_TAG_DELETED);
+
+        if (free_mask != 0) {
+            size_t slot = g * HASH_GROUP_SIZE + (size_t)__builtin_ctz(free_mask);
+
+            if (table->tags[slot] == HASH_TAG_DELETED) {
+                table->tombstones--;
+            }
+
+            __atomic_store_n(&table->slots[slot], page, __ATOMIC_RELEASE);
+            __atomic_store_n(&table->tags[slot], hash_tag(h), __ATOMIC_RELEASE);
+            table->used++;
+            return;
+        }
+
+        g = (g + step + 1) & table->group_mask;
+    }
 }
 
-int cache_flush_file(int fd) {
-    int result = 0;
+/*
+ * An toàn khi gọi không lock (trong một epoch): kết quả có thể sai lệch
+ * khi có ghi đồng thời, caller phải kiểm tra lại bằng seq của page.
+ */
+static page_id_t table_find(const page_hash_table_t *table, uint64_t key, uint64_t h) {
+    uint8_t tag = hash_tag(h);
+    size_t g = hash_group(table, h);
+
+    for (size_t step = 0; step <= table->group_mask; step++) {
+        const uint8_t *tags = &table->tags[g * HASH_GROUP_SIZE];
+        uint32_t mask = group_match(tags, tag);
 
-    for (size_t i = 0; i < g_cache.cache_size; i++) {
-        cache_page_t *page = &g_cache.pages[i];
+        while (mask != 0) {
+            size_t slot = g * HASH_GROUP_SIZE + (size_t)__builtin_ctz(mask);
+            page_id_t page = __atomic_load_n(&table->slots[slot], __ATOMIC_ACQUIRE);
 
-        if (page->valid && page->fd == fd && page->dirty) {
-            if (cache_flush_page(page) < 0) {
-                result = -1;
+            if (page != PAGE_NONE && page_key_of(page) == key) {
+                return page;
             }
+            mask &= mask - 1;
         }
+
+        if (group_match(tags, HASH_TAG_EMPTY) != 0) {
+            return PAGE_NONE;
+        }
+
+        g = (g + step + 1) & table->group_mask;
     }
 
-    return result;
+    return PAGE_NONE;
 }
 
-void cache_invalidate_file(int fd) {
-    for (size_t i = 0; i < g_cache.cache_size; i++) {
-        cache_page_t *page = &g_cache.pages[i];
+/*
+ * Dựng lại bảng với capacity mới (cũng dùng để dọn tombstone). Bảng cũ
+ * chỉ được giải phóng sau khi mọi reader không lock đã rời đi.
+ */
+int hash_resize(cache_shard_t *shard, size_t capacity) {
+    page_hash_table_t *old = shard->hash_table;
+    page_hash_table_t *table = table_create(capacity);
+
+    if (table == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if (old != NULL) {
+        for (size_t i = 0; i < old->capacity; i++) {
+            if ((old->tags[i] & 0x80) != 0) {
+                page_id_t page = old->slots[i];
+                table_insert(table, page, hash_key(page_key_of(page)));
+            }
+        }
+    }
 
-        if (page->valid && page->fd == fd) {
-            hash_remove(page);
+    __atomic_store_n(&shard->hash_table, table, __ATOMIC_RELEASE);
 
-            queue_remove(&g_cache.fifo_queue, page);
+    if (old != NULL) {
+        epoch_synchronize();
+        table_free(old);
+    }
+
+    return 0;
+}
 
-            page->valid = false;
-            page->fd = -1;
-            page->dirty = false;
-            page->reference_bit = false;
+void hash_insert(cache_shard_t *shard, page_id_t page) {
+    page_hash_table_t *table = shard->hash_table;
+
+    /* Giữ ít nhất 1/8 slot EMPTY để việc dò luôn dừng sớm */
+    if ((table->used + table->tombstones + 1) * 8 > table->capacity * 7) {
+        hash_resize(shard, table->capacity);
+        table = shard->hash_table;
+    }
+
+    table_insert(table, page, hash_key(page_key_of(page)));
+}
 
-            page->hash_next = g_cache.free_list;
-            g_cache.free_list = page;
+void hash_remove(cache_shard_t *shard, page_id_t page) {
+    page_hash_table_t *table = shard->hash_table;
+    uint64_t h = hash_key(page_key_of(page));
+    uint8_t tag = hash_tag(h);
+    size_t g = hash_group(table, h);
+
+    for (size_t step = 0; step <= table->group_mask; step++) {
+        uint8_t *tags = &table->tags[g * HASH_GROUP_SIZE];
+        uint32_t mask = group_match(tags, tag);
+
+        while (mask != 0) {
+            size_t slot = g * HASH_GROUP_SIZE + (size_t)__builtin_ctz(mask);
+
+            if (table->slots[slot] == page) {
+                /*
+                 * Nếu nhóm còn slot EMPTY thì mọi lần dò đều dừng ở nhóm này,
+                 * nên có thể trả slot về EMPTY thay vì để tombstone.
+                 */
+                if (group_match(tags, HASH_TAG_EMPTY) != 0) {
+                    __atomic_store_n(&tags[slot % HASH_GROUP_SIZE], HASH_TAG_EMPTY, __ATOMIC_RELEASE);
+                } else {
+                    __atomic_store_n(&tags[slot % HASH_GROUP_SIZE], HASH_TAG_DELETED, __ATOMIC_RELEASE);
+                    table->tombstones++;
+                }
+                __atomic_store_n(&table->slots[slot], PAGE_NONE, __ATOMIC_RELEASE);
+                table->used--;
+                return;
+            }
+            mask &= mask - 1;
+        }
 
-            g_cache.pages_used--;
+        if (group_match(tags, HASH_TAG_EMPTY) != 0) {
+            return;
         }
+
+        g = (g + step + 1) & table->group_mask;
     }
 }
 
-cache_page_t *cache_evict_page(void) {
-    if (g_cache.free_list != NULL) {
-        cache_page_t *page = g_cache.free_list;
-        g_cache.free_list = page->hash_next;
-        page->hash_next = NULL;
+page_id_t hash_lookup(cache_shard_t *shard, uint64_t key) {
+    page_id_t page = table_find(shard->hash_table, key, hash_key(key));
+
+    if (page != PAGE_NONE && page_test(page, PAGE_VALID)) {
         return page;
     }
 
-    while (g_cache.fifo_queue.count > 0) {
-        cache_page_t *page = queue_pop_front(&g_cache.fifo_queue);
+    return PAGE_NONE;
+}
 
-        if (page == NULL) {
-            break;
+static void shards_cleanup(size_t count) {
+    for (size_t s = 0; s < count; s++) {
+        if (g_cache.shards[s].policy_state != NULL) {
+            g_cache.policy->destroy(&g_cache.shards[s]);
         }
+        admission_destroy(&g_cache.shards[s]);
+        pthread_mutex_destroy(&g_cache.shards[s].lock);
+        pthread_cond_destroy(&g_cache.shards[s].io_cond);
+        table_free(g_cache.shards[s].hash_table);
+    }
 
-        if (page->reference_bit) {
+    free(g_cache.shards);
+    g_cache.shards = NULL;
+    g_cache.num_shards = 0;
+}
 
-            page->reference_bit = false;
-            queue_push_back(&g_cache.fifo_queue, page);
+int cache_shards_init(void) {
+    size_t num_shards = 1;
 
-            continue;
+    while (num_shards * 2 <= VTPC_MAX_SHARDS &&
+           g_cache.cache_size / (num_shards * 2) >= VTPC_MIN_PAGES_PER_SHARD) {
+        num_shards *= 2;
+    }
+
+    g_cache.shards = aligned_alloc(64, num_shards * sizeof(cache_shard_t));
+    if (g_cache.shards == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memset(g_cache.shards, 0, num_shards * sizeof(cache_shard_t));
+
+    g_cache.num_shards = num_shards;
+    g_cache.pages_per_shard = g_cache.cache_size / num_shards;
+
+    for (size_t s = 0; s < num_shards; s++) {
+        cache_shard_t *shard = &g_cache.shards[s];
+
+        if (pthread_mutex_init(&shard->lock, NULL) != 0) {
+            shards_cleanup(s);
+            return -1;
+        }
+        pthread_cond_init(&shard->io_cond, NULL);
+        atomic_init(&shard->io_waiters, 0);
+
+        /* Shard cuối nhận thêm phần dư */
+        shard->first_page = (page_id_t)(s * g_cache.pages_per_shard);
+        shard->page_count = (s == num_shards - 1)
+            ? g_cache.cache_size - s * g_cache.pages_per_shard
+            : g_cache.pages_per_shard;
+
+        /* Bảng lớn theo số page của shard, hệ số tải tối đa 1/2 */
+        size_t capacity = HASH_GROUP_SIZE;
+        while (capacity < shard->page_count * 2) {
+            capacity *= 2;
         }
 
-        if (page->dirty) {
-            if (cache_flush_page(page) < 0) {
-                queue_push_back(&g_cache.fifo_queue, page);
-                continue;
-            }
+        if (hash_resize(shard, capacity) < 0) {
+            shards_cleanup(s + 1);
+            return -1;
         }
 
-        hash_remove(page);
+        if (g_cache.policy->init(shard) < 0 ||
+            (g_cache.use_admission && admission_init(shard) < 0)) {
+            shards_cleanup(s + 1);
+            errno = ENOMEM;
+            return -1;
+        }
 
-        page->valid = false;
-        page->fd = -1;
-        page->dirty = false;
-        page->reference_bit = false;
+        shard->free_list = PAGE_NONE;
+        shard->free_count = 0;
+        queue_init(&shard->dirty);
+        shard->victim_write_errors = 0;
+        shard->free_low = shard->page_count * g_cache.reclaim_low_ratio / 100;
+        shard->free_high = 2 * shard->free_low;
+        shard->fresh_next = shard->first_page;
+    }
 
-        g_cache.pages_evicted++;
-        g_cache.pages_used--;
+    return 0;
+}
 
-        return page;
+void cache_shards_destroy(void) {
+    if (g_cache.shards == NULL) {
+        return;
     }
 
-    errno = ENOMEM;
-    return NULL;
+    shards_cleanup(g_cache.num_shards);
+}
+
+void cache_wait_io(cache_shard_t *shard) {
+    atomic_fetch_add(&shard->io_waiters, 1);
+    pthread_cond_wait(&shard->io_cond, &shard->lock);
+    atomic_fetch_sub(&shard->io_waiters, 1);
 }
 
-cache_page_t *cache_find_page(int fd, off_t block_num) {
-    cache_page_t *page = hash_lookup(fd, block_num);
+/* Gọi dưới shard->lock khi page vừa thành dirty: page dirty muộn nhất ở cuối list */
+static void dirty_list_add(cache_shard_t *shard, page_id_t page) {
+    page_link_t *links = g_cache.page_dirty_links;
+    page_queue_t *q = &shard->dirty;
 
-    if (page != NULL) {
-        page->reference_bit = true;
-        g_cache.cache_hits++;
+    links[page].next = PAGE_NONE;
+    links[page].prev = q->tail;
+    if (q->tail != PAGE_NONE) {
+        links[q->tail].next = page;
+    } else {
+        q->head = page;
     }
+    q->tail = page;
+    q->count++;
+}
 
-    return page;
+/* Gọi dưới shard->lock khi page hết dirty hoặc bị bỏ khi còn dirty */
+static void dirty_list_remove(cache_shard_t *shard, page_id_t page) {
+    page_link_t *links = g_cache.page_dirty_links;
+    page_queue_t *q = &shard->dirty;
+
+    if (links[page].prev != PAGE_NONE) {
+        links[links[page].prev].next = links[page].next;
+    } else {
+        q->head = links[page].next;
+    }
+    if (links[page].next != PAGE_NONE) {
+        links[links[page].next].prev = links[page].prev;
+    } else {
+        q->tail = links[page].prev;
+    }
+    q->count--;
 }
 
-cache_page_t *cache_get_page(int fd, off_t block_num, bool load_from_disk) {
-    cache_page_t *page = cache_find_page(fd, block_num);
-    if (page != NULL) {
-        return page;
+static uint64_t *page_sector_map(page_id_t page) {
+    return &g_cache.page_sectors[(size_t)page * g_cache.sector_words];
+}
+
+/*
+ * Gọi dưới shard->lock trước khi nhả lock để ghi: chuyển bitmap sector dirty
+ * của page sang snap. Sector bị ghi đè trong lúc ghi sẽ lại được bật.
+ */
+static void page_take_sectors(page_id_t page, uint64_t *snap) {
+    uint64_t *map = page_sector_map(page);
+
+    for (size_t w = 0; w < VTPC_SECTOR_WORDS; w++) {
+        snap[w] = (w < g_cache.sector_words) ? map[w] : 0;
     }
+    for (size_t w = 0; w < g_cache.sector_words; w++) {
+        map[w] = 0;
+    }
+}
 
-    g_cache.cache_misses++;
+/*
+ * Gọi dưới shard->lock khi ghi xong. Lỗi thì sector trả lại bitmap; page
+ * được làm dirty thêm trong lúc ghi vẫn dirty.
+ */
+static void page_finish_write(cache_shard_t *shard, page_id_t page, const uint64_t *snap, bool ok) {
+    uint64_t *map = page_sector_map(page);
+    uint64_t left = 0;
 
-    page = cache_evict_page();
-    if (page == NULL) {
-        return NULL;
+    page_clear(page, PAGE_WRITING);
+    pthread_cond_broadcast(&shard->io_cond);
+
+    for (size_t w = 0; w < g_cache.sector_words; w++) {
+        if (!ok) {
+            map[w] |= snap[w];
+        }
+        left |= map[w];
+    }
+
+    if (!ok) {
+        return;
+    }
+
+    if (left == 0) {
+        page_clear(page, PAGE_DIRTY);
+        dirty_list_remove(shard, page);
+        atomic_fetch_sub(&g_cache.dirty_pages, 1);
+    }
+    shard->pages_written_back++;
+}
+
+/* Page dirty đã mang PAGE_WRITING, chờ được ghi chung trong một lô */
+typedef struct {
+    size_t count;
+    file_entry_t *files[VTPC_CLUSTER_MAX];
+    off_t blocks[VTPC_CLUSTER_MAX];
+    page_id_t pages[VTPC_CLUSTER_MAX];
+    uint64_t snaps[VTPC_CLUSTER_MAX][VTPC_SECTOR_WORDS];
+} flush_batch_t;
+
+/* Gọi dưới lock của shard chứa page; page phải dirty và không bận */
+static void flush_batch_add(flush_batch_t *batch, file_entry_t *file, off_t block, page_id_t page) {
+    size_t i = batch->count++;
+
+    page_take_sectors(page, batch->snaps[i]);
+    page_set(page, PAGE_WRITING);
+    batch->files[i] = file;
+    batch->blocks[i] = block;
+    batch->pages[i] = page;
+}
+
+/*
+ * Gọi khi không giữ lock nào: ghi các sector dirty của cả lô theo bitmap
+ * đã chụp. Mỗi dải byte dirty liên tục (cùng file, kể cả qua biên page) là
+ * một yêu cầu, các yêu cầu được gửi cùng nhau. Thiết bị O_DIRECT từ chối ghi
+ * nhỏ hơn page thì file chuyển hẳn sang ghi cả page.
+ */
+static int flush_batch_write(flush_batch_t *batch) {
+    size_t page_size = g_cache.page_size;
+    size_t sector_size = g_cache.sector_size;
+    size_t written = 0;
+    io_batch_t io;
+
+    io_batch_init(&io);
+
+    for (size_t i = 0; i < batch->count; i++) {
+        file_entry_t *file = batch->files[i];
+        bool full = atomic_load(&file->dio_full_pages);
+        char *data = cache_page_data(batch->pages[i]);
+        off_t base = batch->blocks[i] * (off_t)page_size;
+
+        for (size_t s = 0; s < g_cache.sectors_per_page; s++) {
+            if (!full && ((batch->snaps[i][s / 64] >> (s % 64)) & 1) == 0) {
+                continue;
+            }
+
+            size_t offset = s * sector_size;
+            size_t len = (page_size - offset < sector_size) ? page_size - offset : sector_size;
+
+            io_batch_add(&io, file->real_fd, true, base + (off_t)offset, data + offset, len);
+            written += len;
+        }
     }
 
-    page->fd = fd;
-    page->block_num = block_num;
-    page->valid = true;
-    page->dirty = false;
-    page->reference_bit = true;
+    if (io_batch_submit(&io) < 0) {
+        bool retry = false;
 
-    hash_insert(page);
+        for (size_t i = 0; errno == EINVAL && i < batch->count; i++) {
+            file_entry_t *file = batch->files[i];
 
-    queue_push_back(&g_cache.fifo_queue, page);
+            if (file->direct && !atomic_exchange(&file->dio_full_pages, true)) {
+                retry = true;
+            }
+        }
+        if (retry) {
+            return flush_batch_write(batch);
+        }
+        return -1;
+    }
 
-    g_cache.pages_used++;
+    atomic_fetch_add(&g_cache.write_bytes_saved, batch->count * page_size - written);
 
-    if (load_from_disk) {
-        file_entry_t *file = get_file_entry(fd);
+    return 0;
+}
+
+/* Trả page của lô về trạng thái thường; lock của held đang được caller giữ */
+static void flush_batch_finish(flush_batch_t *batch, bool ok, cache_shard_t *held) {
+    for (size_t i = 0; i < batch->count; i++) {
+        page_id_t page = batch->pages[i];
+        cache_shard_t *shard = cache_page_shard(page);
+
+        if (shard != held) {
+            pthread_mutex_lock(&shard->lock);
+        }
+        page_finish_write(shard, page, batch->snaps[i], ok);
+        if (shard != held) {
+            pthread_mutex_unlock(&shard->lock);
+        }
+    }
+
+    batch->count = 0;
+}
+
+/*
+ * Gọi khi đang giữ shard->lock với tối đa VTPC_CLUSTER_MAX page của shard.
+ * Page dirty trong số đó được ghi chung một lô; lock được nhả trong lúc ghi,
+ * page được đánh dấu PAGE_WRITING để các thread khác chờ. Trả về số page
+ * đã ghi, -1 nếu lỗi (mọi page của lô vẫn dirty).
+ */
+int cache_flush_pages(cache_shard_t *shard, const page_id_t *pages, size_t n) {
+    flush_batch_t batch;
+
+    batch.count = 0;
+
+    for (size_t i = 0; i < n && i < VTPC_CLUSTER_MAX; i++) {
+        page_id_t page = pages[i];
+        unsigned flags = page_flags(page);
+
+        /* Không cần flush nếu không dirty */
+        if ((flags & PAGE_VALID) == 0 || (flags & PAGE_DIRTY) == 0 || (flags & PAGE_BUSY) != 0) {
+            continue;
+        }
+
+        uint64_t key = page_key_of(page);
+        file_entry_t *file = get_file_entry(page_key_fd(key));
         if (file == NULL || !file->in_use) {
-            hash_remove(page);
-            queue_remove(&g_cache.fifo_queue, page);
-            page->valid = false;
-            page->fd = -1;
-            page->hash_next = g_cache.free_list;
-            g_cache.free_list = page;
-            g_cache.pages_used--;
+            continue;
+        }
 
+        flush_batch_add(&batch, file, page_key_block(key), page);
+    }
+
+    if (batch.count == 0) {
+        return 0;
+    }
+
+    size_t count = batch.count;
+
+    pthread_mutex_unlock(&shard->lock);
+    int result = flush_batch_write(&batch);
+    int saved_errno = errno;
+    pthread_mutex_lock(&shard->lock);
+
+    flush_batch_finish(&batch, result == 0, shard);
+
+    if (result < 0) {
+        errno = saved_errno;
+        return -1;
+    }
+
+    return (int)count;
+}
+
+/* Như cache_flush_pages() cho một page */
+int cache_flush_page(cache_shard_t *shard, page_id_t page) {
+    unsigned flags = page_flags(page);
+
+    if ((flags & PAGE_VALID) != 0 && (flags & PAGE_DIRTY) != 0 && (flags & PAGE_BUSY) == 0) {
+        file_entry_t *file = get_file_entry(page_key_fd(page_key_of(page)));
+        if (file == NULL || !file->in_use) {
             errno = EBADF;
-            return NULL;
+            return -1;
         }
+    }
 
-        memset(page->data, 0, g_cache.page_size);
+    return (cache_flush_pages(shard, &page, 1) < 0) ? -1 : 0;
+}
 
-        ssize_t bytes_read = direct_read_block(
-            file->real_fd,
-            block_num,
-            page->data,
-            g_cache.page_size
-        );
+#define INDEX_BATCH 64
+
+static int index_insert(page_id_t page) {
+    uint64_t key = page_key_of(page);
+    file_entry_t *file = get_file_entry(page_key_fd(key));
+
+    pthread_mutex_lock(&file->index_lock);
+    int result = radix_insert(&file->page_index, (uint64_t)page_key_block(key), page);
+    pthread_mutex_unlock(&file->index_lock);
+
+    return result;
+}
+
+static void index_remove(page_id_t page) {
+    uint64_t key = page_key_of(page);
+    file_entry_t *file = get_file_entry(page_key_fd(key));
+
+    pthread_mutex_lock(&file->index_lock);
+    radix_delete(&file->page_index, (uint64_t)page_key_block(key));
+    pthread_mutex_unlock(&file->index_lock);
+}
+
+/* Page không còn chủ; seq phải đang lẻ */
+static void page_reset(page_id_t page) {
+    atomic_fetch_add(&g_cache.page_generation[page], 1);
+    atomic_store(&g_cache.page_flags[page], 0);
+    page_set_key(page, PAGE_KEY_NONE);
+    memset(page_sector_map(page), 0, g_cache.sector_words * sizeof(uint64_t));
+}
+
+/* Gỡ page khỏi cửa sổ của bộ lọc nhận hoặc khỏi policy */
+static void policy_remove(cache_shard_t *shard, page_id_t page, bool evicted) {
+    if (page_test(page, PAGE_WINDOW)) {
+        admission_remove(shard, page);
+    } else {
+        g_cache.policy->on_remove(shard, page, evicted);
+    }
+}
 
-        (void)bytes_read;
+/* Đưa page về cuối ít bị evict nhất của nơi nó đang nằm, không nâng hạng */
+static void policy_requeue(cache_shard_t *shard, page_id_t page) {
+    if (page_test(page, PAGE_WINDOW)) {
+        admission_remove(shard, page);
+        admission_insert(shard, page);
     } else {
-        memset(page->data, 0, g_cache.page_size);
+        g_cache.policy->on_remove(shard, page, false);
+        g_cache.policy->on_insert(shard, page, false);
     }
+}
 
-    return page;
+/* Page của một lần đọc tuần tự bỏ qua cửa sổ, vào thẳng đầu bị evict của policy */
+static void policy_insert(cache_shard_t *shard, page_id_t page, unsigned hint) {
+    if (hint & ACCESS_STREAM) {
+        g_cache.policy->on_insert(shard, page, true);
+        shard->stream_inserts++;
+    } else if (shard->admission != NULL) {
+        admission_insert(shard, page);
+    } else {
+        g_cache.policy->on_insert(shard, page, false);
+    }
+}
+
+/*
+ * Có thể gọi không lock khi policy cho phép lockless_hit. Đọc tiếp trong
+ * page hiện tại của một lần quét chỉ được đếm, không nâng hạng page và
+ * không vào sketch.
+ */
+static void policy_hit(cache_shard_t *shard, page_id_t page, uint64_t key, unsigned hint) {
+    /* Lần đọc đầu của page đọc trước thay cho lần miss, không nâng hạng */
+    if (page_test(page, PAGE_PREFETCHED) &&
+        (atomic_fetch_and(&g_cache.page_flags[page], ~PAGE_PREFETCHED) & PAGE_PREFETCHED)) {
+        atomic_fetch_add_explicit(&shard->prefetch_hits, 1, memory_order_relaxed);
+        return;
+    }
+    if (hint & ACCESS_REREAD) {
+        return;
+    }
+    if (!page_test(page, PAGE_WINDOW)) {
+        g_cache.policy->on_hit(shard, page);
+    }
+    if (shard->admission != NULL) {
+        admission_record(shard, key);
+    }
+}
+
+/* Page đọc trước bị bỏ khi chưa ai đọc; file dùng số này để thu nhỏ cửa sổ */
+static void prefetch_note_dropped(cache_shard_t *shard, page_id_t page) {
+    if (page_test(page, PAGE_PREFETCHED)) {
+        file_entry_t *file = get_file_entry(page_key_fd(page_key_of(page)));
+
+        shard->prefetch_wasted++;
+        atomic_fetch_add(&file->ra_wasted, 1);
+    }
+}
+
+/*
+ * Gọi khi đang giữ shard->lock; page vẫn còn trong hash và queue. Không ai
+ * khác được giữ page: chỉ caller (nạp lỗi) hoặc refcount đã về 0.
+ */
+static void page_discard(cache_shard_t *shard, page_id_t page) {
+    prefetch_note_dropped(shard, page);
+    if (page_test(page, PAGE_DIRTY)) {
+        dirty_list_remove(shard, page);
+        atomic_fetch_sub(&g_cache.dirty_pages, 1);
+    }
+    hash_remove(shard, page);
+    policy_remove(shard, page, false);
+    index_remove(page);
+
+    if ((atomic_load(&g_cache.page_seq[page]) & 1) == 0) {
+        cache_page_write_begin(page);
+    }
+    page_reset(page);
+    atomic_store(&g_cache.page_refcount[page], 0);
+
+    g_cache.page_links[page].next = shard->free_list;
+    shard->free_list = page;
+    shard->free_count++;
+
+    shard->pages_used--;
+}
+
+static bool page_is(page_id_t page, uint64_t key) {
+    return page_test(page, PAGE_VALID) && page_key_of(page) == key;
+}
+
+/*
+ * Gọi dưới shard->lock: nếu page đang bị giữ thì chờ một lần đánh thức.
+ * io_waiters được tăng trước khi đọc refcount để cache_put_page() không bỏ
+ * lỡ lần báo. Trả về false nếu page không bị ai giữ.
+ */
+static bool page_wait_unheld(cache_shard_t *shard, page_id_t page) {
+    atomic_fetch_add(&shard->io_waiters, 1);
+
+    bool held = atomic_load(&g_cache.page_refcount[page]) > 0;
+    if (held) {
+        pthread_cond_wait(&shard->io_cond, &shard->lock);
+    }
+
+    atomic_fetch_sub(&shard->io_waiters, 1);
+
+    return held;
+}
+
+/*
+ * Duyệt các page của fd trong [first_block, last_block] theo thứ tự offset
+ * nhờ index của file. Index chỉ được giữ lock lúc lấy một lô; mỗi page được
+ * kiểm tra lại dưới lock của shard vì có thể đã bị evict trong lúc đó. Khi
+ * flush, page dirty được gom thành lô VTPC_CLUSTER_MAX page và ghi chung.
+ * Khi invalidate, page chỉ bị bỏ sau khi mọi ref đã được nhả; caller giữ
+ * file->lock nên ref mới chỉ có thể đến từ lượt nạp không lock của aio.c,
+ * vốn nhả ref mà không cần lock nào.
+ */
+static int walk_range(int fd, off_t first_block, off_t last_block, bool invalidate) {
+    file_entry_t *file = get_file_entry(fd);
+    if (file == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    page_id_t pages[INDEX_BATCH];
+    uint64_t blocks[INDEX_BATCH];
+    uint64_t next = (uint64_t)first_block;
+    flush_batch_t batch;
+    bool done = false;
+    int result = 0;
+
+    batch.count = 0;
+
+    while (!done) {
+        pthread_mutex_lock(&file->index_lock);
+        size_t n = radix_gather(&file->page_index, next, pages, blocks, INDEX_BATCH);
+        pthread_mutex_unlock(&file->index_lock);
+
+        if (n == 0) {
+            break;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            if (blocks[i] > (uint64_t)last_block) {
+                done = true;
+                break;
+            }
+
+            if (batch.count == VTPC_CLUSTER_MAX) {
+                int written = flush_batch_write(&batch);
+                if (written < 0) {
+                    result = -1;
+                }
+                flush_batch_finish(&batch, written == 0, NULL);
+            }
+
+            page_id_t page = pages[i];
+            uint64_t key = page_key(fd, (off_t)blocks[i]);
+            cache_shard_t *shard = cache_page_shard(page);
+
+            pthread_mutex_lock(&shard->lock);
+
+            while (page_is(page, key)) {
+                if (!page_test(page, PAGE_BUSY)) {
+                    /* Page còn bị giữ (worker bất đồng bộ đang nạp) không được đem dùng lại */
+                    if (invalidate && page_wait_unheld(shard, page)) {
+                        continue;
+                    }
+                    break;
+                }
+                /* Không chờ khi còn giữ PAGE_WRITING của lô: hai lần flush có thể chờ nhau */
+                if (batch.count > 0) {
+                    pthread_mutex_unlock(&shard->lock);
+                    int written = flush_batch_write(&batch);
+                    if (written < 0) {
+                        result = -1;
+                    }
+                    flush_batch_finish(&batch, written == 0, NULL);
+                    pthread_mutex_lock(&shard->lock);
+                    continue;
+                }
+                cache_wait_io(shard);
+            }
+
+            if (page_is(page, key)) {
+                if (invalidate) {
+                    page_discard(shard, page);
+                } else if (page_test(page, PAGE_DIRTY)) {
+                    flush_batch_add(&batch, file, (off_t)blocks[i], page);
+                }
+            }
+
+            pthread_mutex_unlock(&shard->lock);
+        }
+
+        next = blocks[n - 1] + 1;
+    }
+
+    if (batch.count > 0) {
+        int written = flush_batch_write(&batch);
+        if (written < 0) {
+            result = -1;
+        }
+        flush_batch_finish(&batch, written == 0, NULL);
+    }
+
+    return result;
+}
+
+int cache_flush_range(int fd, off_t first_block, off_t last_block) {
+    return walk_range(fd, first_block, last_block, false);
+}
+
+int cache_flush_file(int fd) {
+    return walk_range(fd, 0, INT64_MAX, false);
+}
+
+void cache_invalidate_range(int fd, off_t first_block, off_t last_block) {
+    walk_range(fd, first_block, last_block, true);
+}
+
+void cache_invalidate_file(int fd) {
+    walk_range(fd, 0, INT64_MAX, true);
+}
+
+/* Gỡ victim của policy khỏi cache; lỗi như cache_evict_page() */
+static page_id_t evict_victim(cache_shard_t *shard, bool background) {
+    page_id_t page;
+
+    if (shard->admission == NULL) {
+        page = g_cache.policy->choose_victim(shard);
+    } else {
+        page = background ? admission_reclaim_victim(shard) : admission_choose_victim(shard);
+    }
+    if (page == PAGE_NONE) {
+        return PAGE_NONE;
+    }
+
+    /*
+     * Victim dirty vẫn nằm trong policy; ghi xong thì lần hỏi sau sẽ evict
+     * được. Ghi lỗi thì page vẫn dirty và về cuối ít bị evict nhất, để lần
+     * hỏi sau lấy page khác thay vì làm hỏng mọi miss của shard. Chỉ khi
+     * chừng ấy lần liên tiếp như số page đang dùng đều lỗi mới trả lỗi ghi.
+     */
+    if (page_test(page, PAGE_DIRTY)) {
+        if (cache_flush_page(shard, page) < 0) {
+            int saved_errno = errno;
+
+            if (page_test(page, PAGE_DIRTY) && !page_test(page, PAGE_BUSY)) {
+                policy_requeue(shard, page);
+            }
+            if (++shard->victim_write_errors >= shard->pages_used) {
+                shard->victim_write_errors = 0;
+                errno = saved_errno;
+                return PAGE_NONE;
+            }
+        } else {
+            shard->victim_write_errors = 0;
+        }
+
+        errno = EAGAIN;
+        return PAGE_NONE;
+    }
+
+    shard->victim_write_errors = 0;
+    prefetch_note_dropped(shard, page);
+    hash_remove(shard, page);
+    policy_remove(shard, page, true);
+    index_remove(page);
+
+    cache_page_write_begin(page);
+    page_reset(page);
+
+    shard->pages_evicted++;
+    shard->pages_used--;
+
+    return page;
+}
+
+/*
+ * Gọi khi đang giữ shard->lock. Trả về PAGE_NONE với:
+ *   EAGAIN - lock đã bị nhả để ghi một victim dirty, caller phải lookup lại;
+ *   EBUSY  - mọi page đều đang I/O hoặc đang bị pin.
+ */
+page_id_t cache_evict_page(cache_shard_t *shard) {
+    if (shard->free_list != PAGE_NONE) {
+        page_id_t page = shard->free_list;
+        shard->free_list = g_cache.page_links[page].next;
+        g_cache.page_links[page].next = PAGE_NONE;
+        shard->free_count--;
+        return page;
+    }
+
+    /* Page chưa từng dùng: seq đang là 0, chuyển sang lẻ như page vừa evict */
+    if (shard->fresh_next < shard->first_page + shard->page_count) {
+        page_id_t page = shard->fresh_next++;
+        cache_page_write_begin(page);
+        return page;
+    }
+
+    /*
+     * Luồng thu hồi không theo kịp (hoặc bị tắt): miss tự tìm victim. Chỉ
+     * đánh thức luồng ở đây, còn lại nó chạy theo chu kỳ, để mỗi lần dậy
+     * thu hồi cả lô thay vì vài page mỗi miss.
+     */
+    if (shard->free_low > 0) {
+        reclaim_kick();
+    }
+
+    page_id_t page = evict_victim(shard, false);
+    if (page != PAGE_NONE) {
+        shard->direct_evictions++;
+    }
+
+    return page;
+}
+
+/*
+ * Cho luồng thu hồi: khi shard đã dùng hết page chưa từng dùng và free list
+ * dưới free_low, evict victim vào free list cho tới free_high. Lock được nhả
+ * sau mỗi VTPC_RECLAIM_BATCH page để miss không phải chờ lâu.
+ */
+size_t cache_reclaim_shard(cache_shard_t *shard) {
+    size_t reclaimed = 0;
+
+    pthread_mutex_lock(&shard->lock);
+
+    if (shard->fresh_next < shard->first_page + shard->page_count ||
+        shard->free_count >= shard->free_low) {
+        pthread_mutex_unlock(&shard->lock);
+        return 0;
+    }
+
+    while (shard->free_count < shard->free_high) {
+        page_id_t page = evict_victim(shard, true);
+        if (page == PAGE_NONE) {
+            if (errno == EAGAIN) {
+                continue;
+            }
+            break;
+        }
+
+        g_cache.page_links[page].next = shard->free_list;
+        shard->free_list = page;
+        shard->free_count++;
+        shard->pages_reclaimed++;
+        reclaimed++;
+
+        if (reclaimed % VTPC_RECLAIM_BATCH == 0) {
+            pthread_mutex_unlock(&shard->lock);
+            pthread_mutex_lock(&shard->lock);
+        }
+    }
+
+    /* Miss đang chờ vì mọi page bị pin có thể lấy page trống */
+    if (reclaimed > 0 && atomic_load(&shard->io_waiters) > 0) {
+        pthread_cond_broadcast(&shard->io_cond);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return reclaimed;
+}
+
+/*
+ * Gọi dưới shard->lock với page vừa lấy từ cache_evict_page(): gắn key,
+ * đưa vào hash, policy và index của file. Lỗi thì page về free list.
+ */
+static int page_install(cache_shard_t *shard, page_id_t page, uint64_t key,
+                        unsigned flags, unsigned hint) {
+    page_set_key(page, key);
+    atomic_store(&g_cache.page_flags[page], flags);
+
+    hash_insert(shard, page);
+
+    policy_insert(shard, page, hint);
+
+    shard->pages_used++;
+
+    if (index_insert(page) < 0) {
+        page_discard(shard, page);
+        pthread_cond_broadcast(&shard->io_cond);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Nhả lock trong lúc đọc block vào page đang PAGE_READING rồi lấy lại.
+ * Lỗi đọc thì page bị bỏ và errno được giữ nguyên.
+ */
+static int page_fill(cache_shard_t *shard, page_id_t page, file_entry_t *file,
+                     off_t block_num, bool load_from_disk) {
+    pthread_mutex_unlock(&shard->lock);
+
+    void *data = cache_page_data(page);
+    memset(data, 0, g_cache.page_size);
+
+    ssize_t bytes_read = 0;
+    if (load_from_disk) {
+        bytes_read = direct_read_block(
+            file->real_fd,
+            block_num,
+            data,
+            g_cache.page_size
+        );
+    }
+    int saved_errno = errno;
+
+    pthread_mutex_lock(&shard->lock);
+
+    page_clear(page, PAGE_READING);
+    pthread_cond_broadcast(&shard->io_cond);
+
+    if (bytes_read < 0) {
+        page_discard(shard, page);
+        errno = saved_errno;
+        return -1;
+    }
+
+    /* seq đã lẻ từ lúc page rời free list hoặc bị evict */
+    cache_page_write_end(page);
+
+    return 0;
+}
+
+/*
+ * Đọc các page của block liên tiếp đang PAGE_READING bằng một lần preadv,
+ * không giữ lock nào. Lỗi đọc thì mọi page bị bỏ và errno được giữ nguyên.
+ */
+static int pages_fill(file_entry_t *file, off_t first_block, const page_id_t *pages, size_t n) {
+    void *bufs[VTPC_CLUSTER_MAX];
+
+    for (size_t i = 0; i < n; i++) {
+        bufs[i] = cache_page_data(pages[i]);
+        memset(bufs[i], 0, g_cache.page_size);
+    }
+
+    ssize_t bytes_read = direct_read_vec(file->real_fd, first_block, bufs, n, g_cache.page_size);
+    int saved_errno = errno;
+
+    for (size_t i = 0; i < n; i++) {
+        cache_shard_t *shard = cache_page_shard(pages[i]);
+
+        pthread_mutex_lock(&shard->lock);
+
+        page_clear(pages[i], PAGE_READING);
+        pthread_cond_broadcast(&shard->io_cond);
+
+        if (bytes_read < 0) {
+            page_discard(shard, pages[i]);
+        } else {
+            cache_page_write_end(pages[i]);
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    if (bytes_read < 0) {
+        errno = saved_errno;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Gọi dưới shard->lock: lấy một page cho key mà không chờ. Trả về
+ * PAGE_NONE nếu key đã có trong cache (EEXIST) hoặc không evict được ngay.
+ */
+static page_id_t page_claim(cache_shard_t *shard, uint64_t key) {
+    for (;;) {
+        if (hash_lookup(shard, key) != PAGE_NONE) {
+            errno = EEXIST;
+            return PAGE_NONE;
+        }
+
+        page_id_t page = cache_evict_page(shard);
+        if (page != PAGE_NONE || errno != EAGAIN) {
+            return page;
+        }
+    }
+}
+
+/*
+ * Số block liên tiếp từ first_block không có page trong cache (kể cả page
+ * đang nạp), tối đa max_blocks. Caller giữ file->lock nên không page nào
+ * của file có thể được thêm vào trong lúc đó, trừ khi được nạp từ đĩa.
+ */
+size_t cache_uncached_run(int fd, off_t first_block, size_t max_blocks) {
+    file_entry_t *file = get_file_entry(fd);
+    page_id_t page;
+    uint64_t block;
+
+    pthread_mutex_lock(&file->index_lock);
+    size_t n = radix_gather(&file->page_index, (uint64_t)first_block, &page, &block, 1);
+    pthread_mutex_unlock(&file->index_lock);
+
+    if (n == 0 || block - (uint64_t)first_block >= max_blocks) {
+        return max_blocks;
+    }
+
+    return (size_t)(block - (uint64_t)first_block);
+}
+
+page_id_t cache_find_page(cache_shard_t *shard, uint64_t key, unsigned hint) {
+    page_id_t page = hash_lookup(shard, key);
+
+    if (page != PAGE_NONE && !page_test(page, PAGE_BUSY) && !(hint & ACCESS_QUIET)) {
+        policy_hit(shard, page, key, hint);
+        atomic_fetch_add_explicit(&shard->cache_hits, 1, memory_order_relaxed);
+    }
+
+    return page;
+}
+
+/*
+ * Trả về page đã được pin (refcount > 0), lock của shard đã được nhả.
+ * Caller phải gọi cache_put_page() sau khi dùng xong. Nhiều thread miss
+ * cùng một block sẽ chờ một lần đọc duy nhất.
+ */
+page_id_t cache_get_page(int fd, off_t block_num, bool load_from_disk, unsigned hint) {
+    file_entry_t *file = get_file_entry(fd);
+    if (file == NULL || !file->in_use) {
+        errno = EBADF;
+        return PAGE_NONE;
+    }
+
+    uint64_t key = page_key(fd, block_num);
+    cache_shard_t *shard = cache_shard_of(fd, block_num);
+    page_id_t page;
+    bool counted_miss = false;
+
+    pthread_mutex_lock(&shard->lock);
+
+    for (;;) {
+        page = cache_find_page(shard, key, hint);
+        if (page != PAGE_NONE) {
+            if (page_test(page, PAGE_BUSY)) {
+                cache_wait_io(shard);
+                continue;
+            }
+
+            atomic_fetch_add(&g_cache.page_refcount[page], 1);
+            pthread_mutex_unlock(&shard->lock);
+            return page;
+        }
+
+        if (!counted_miss) {
+            shard->cache_misses++;
+            if (shard->admission != NULL && !(hint & ACCESS_STREAM)) {
+                admission_record(shard, key);
+            }
+            counted_miss = true;
+        }
+
+        page = cache_evict_page(shard);
+        if (page != PAGE_NONE) {
+            break;
+        }
+
+        if (errno == EBUSY) {
+            /*
+             * Đăng ký chờ trước khi quét lại, để cache_put_page() thấy
+             * io_waiters và không bỏ lỡ lần đánh thức.
+             */
+            atomic_fetch_add(&shard->io_waiters, 1);
+            page = cache_evict_page(shard);
+            if (page == PAGE_NONE && errno == EBUSY) {
+                pthread_cond_wait(&shard->io_cond, &shard->lock);
+            }
+            atomic_fetch_sub(&shard->io_waiters, 1);
+
+            if (page != PAGE_NONE) {
+                break;
+            }
+            continue;
+        }
+
+        if (errno == EAGAIN) {
+            continue;
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+        return PAGE_NONE;
+    }
+
+    atomic_store(&g_cache.page_refcount[page], 1);
+
+    if (page_install(shard, page, key, PAGE_VALID | PAGE_READING, hint) < 0 ||
+        page_fill(shard, page, file, block_num, load_from_disk) < 0) {
+        pthread_mutex_unlock(&shard->lock);
+        return PAGE_NONE;
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+
+    return page;
+}
+
+/*
+ * Như cache_get_page() cho tối đa nblocks block liên tiếp. Nếu first_block
+ * chưa có trong cache, các block chưa có ngay sau nó được nạp cùng bằng một
+ * lần preadv; chỉ lấy page không phải chờ, dừng ở block đầu tiên đã có.
+ * Trả về số page đã pin vào pages (ít nhất 1), 0 nếu lỗi.
+ */
+size_t cache_get_pages(int fd, off_t first_block, size_t nblocks, unsigned hint, page_id_t *pages) {
+    file_entry_t *file = get_file_entry(fd);
+    if (file == NULL || !file->in_use) {
+        errno = EBADF;
+        return 0;
+    }
+
+    if (nblocks > VTPC_CLUSTER_MAX) {
+        nblocks = VTPC_CLUSTER_MAX;
+    }
+
+    size_t run = (nblocks > 1) ? cache_uncached_run(fd, first_block, nblocks) : 0;
+    size_t claimed = 0;
+
+    while (claimed < run) {
+        off_t block_num = first_block + (off_t)claimed;
+        uint64_t key = page_key(fd, block_num);
+        cache_shard_t *shard = cache_shard_of(fd, block_num);
+
+        pthread_mutex_lock(&shard->lock);
+
+        page_id_t page = page_claim(shard, key);
+        if (page == PAGE_NONE) {
+            pthread_mutex_unlock(&shard->lock);
+            break;
+        }
+
+        shard->cache_misses++;
+        if (shard->admission != NULL && !(hint & ACCESS_STREAM)) {
+            admission_record(shard, key);
+        }
+
+        atomic_store(&g_cache.page_refcount[page], 1);
+
+        if (page_install(shard, page, key, PAGE_VALID | PAGE_READING, hint) < 0) {
+            pthread_mutex_unlock(&shard->lock);
+            break;
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+
+        pages[claimed++] = page;
+    }
+
+    /* Block đầu đã có, đang nạp, hoặc phải chờ page trống */
+    if (claimed == 0) {
+        pages[0] = cache_get_page(fd, first_block, true, hint);
+        return (pages[0] == PAGE_NONE) ? 0 : 1;
+    }
+
+    if (pages_fill(file, first_block, pages, claimed) < 0) {
+        return 0;
+    }
+
+    return claimed;
+}
+
+/*
+ * Pin nblocks page liên tiếp chỉ khi tất cả đã có và không bận; không bao
+ * giờ chờ I/O hay page trống. Hit được tính khi lấy được cả dải, còn thiếu
+ * page nào thì không page nào bị giữ và cũng không tính miss.
+ */
+bool cache_try_get_pages(int fd, off_t first_block, size_t nblocks, page_id_t *pages) {
+    for (size_t i = 0; i < nblocks; i++) {
+        off_t block_num = first_block + (off_t)i;
+        cache_shard_t *shard = cache_shard_of(fd, block_num);
+
+        pthread_mutex_lock(&shard->lock);
+
+        page_id_t page = hash_lookup(shard, page_key(fd, block_num));
+        if (page == PAGE_NONE || page_test(page, PAGE_BUSY)) {
+            pthread_mutex_unlock(&shard->lock);
+            while (i > 0) {
+                cache_put_page(pages[--i], false);
+            }
+            return false;
+        }
+
+        atomic_fetch_add(&g_cache.page_refcount[page], 1);
+        pthread_mutex_unlock(&shard->lock);
+
+        pages[i] = page;
+    }
+
+    /* Page đã pin không bị evict nên có thể cập nhật policy ở lượt thứ hai */
+    for (size_t i = 0; i < nblocks; i++) {
+        off_t block_num = first_block + (off_t)i;
+        cache_shard_t *shard = cache_page_shard(pages[i]);
+
+        pthread_mutex_lock(&shard->lock);
+        policy_hit(shard, pages[i], page_key(fd, block_num), 0);
+        atomic_fetch_add_explicit(&shard->cache_hits, 1, memory_order_relaxed);
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return true;
+}
+
+/*
+ * Nạp trước tối đa VTPC_CLUSTER_MAX block cho luồng đọc trước: page không
+ * bị pin và chưa tính là hit hay miss cho tới lần đọc đầu tiên. Block đã có
+ * được bỏ qua; dừng ở block đầu tiên shard không có page evict được ngay.
+ * Các lần đọc được gửi chung một lô, block liền nhau chung một yêu cầu.
+ * Trả về số page đã nạp, -1 nếu đọc lỗi (page của lô bị bỏ).
+ */
+int cache_prefetch_pages(int fd, off_t first_block, size_t nblocks, unsigned hint) {
+    file_entry_t *file = get_file_entry(fd);
+    page_id_t pages[VTPC_CLUSTER_MAX];
+    off_t blocks[VTPC_CLUSTER_MAX];
+    size_t claimed = 0;
+
+    if (nblocks > VTPC_CLUSTER_MAX) {
+        nblocks = VTPC_CLUSTER_MAX;
+    }
+
+    for (size_t i = 0; i < nblocks; i++) {
+        off_t block_num = first_block + (off_t)i;
+        uint64_t key = page_key(fd, block_num);
+        cache_shard_t *shard = cache_shard_of(fd, block_num);
+
+        pthread_mutex_lock(&shard->lock);
+
+        page_id_t page = page_claim(shard, key);
+        if (page == PAGE_NONE) {
+            pthread_mutex_unlock(&shard->lock);
+            if (errno == EEXIST) {
+                continue;
+            }
+            break;
+        }
+
+        atomic_store(&g_cache.page_refcount[page], 0);
+
+        if (page_install(shard, page, key, PAGE_VALID | PAGE_READING | PAGE_PREFETCHED, hint) < 0) {
+            pthread_mutex_unlock(&shard->lock);
+            break;
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+
+        pages[claimed] = page;
+        blocks[claimed] = block_num;
+        claimed++;
+    }
+
+    if (claimed == 0) {
+        return 0;
+    }
+
+    io_batch_t io;
+    io_batch_init(&io);
+
+    for (size_t i = 0; i < claimed; i++) {
+        void *data = cache_page_data(pages[i]);
+
+        memset(data, 0, g_cache.page_size);
+        io_batch_add(&io, file->real_fd, false, blocks[i] * (off_t)g_cache.page_size,
+                     data, g_cache.page_size);
+    }
+
+    int result = io_batch_submit(&io);
+
+    for (size_t i = 0; i < claimed; i++) {
+        cache_shard_t *shard = cache_page_shard(pages[i]);
+
+        pthread_mutex_lock(&shard->lock);
+
+        page_clear(pages[i], PAGE_READING);
+        pthread_cond_broadcast(&shard->io_cond);
+
+        if (result < 0) {
+            page_discard(shard, pages[i]);
+        } else {
+            cache_page_write_end(pages[i]);
+            shard->pages_prefetched++;
+        }
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return (result < 0) ? -1 : (int)claimed;
+}
+
+/* Như cache_put_page(page, true) nhưng chỉ các sector chạm tới [offset, offset + len) dirty */
+void cache_put_page_dirty(page_id_t page, size_t offset, size_t len) {
+    cache_shard_t *shard = cache_page_shard(page);
+    uint64_t *map = page_sector_map(page);
+    size_t last = (len > 0) ? (offset + len - 1) / g_cache.sector_size : 0;
+
+    pthread_mutex_lock(&shard->lock);
+
+    for (size_t s = offset / g_cache.sector_size; len > 0 && s <= last; s++) {
+        map[s / 64] |= 1ull << (s % 64);
+    }
+
+    /* Tuổi tính từ lần đầu thành dirty, ghi tiếp không làm page trẻ lại */
+    if (!page_test(page, PAGE_DIRTY)) {
+        g_cache.page_dirtied[page] = writeback_clock_ms();
+        dirty_list_add(shard, page);
+        atomic_fetch_add(&g_cache.dirty_pages, 1);
+        page_set(page, PAGE_DIRTY);
+    }
+    atomic_fetch_sub(&g_cache.page_refcount[page], 1);
+    pthread_cond_broadcast(&shard->io_cond);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void cache_put_page(page_id_t page, bool dirty) {
+    cache_shard_t *shard = cache_page_shard(page);
+
+    if (dirty) {
+        cache_put_page_dirty(page, 0, g_cache.page_size);
+        return;
+    }
+
+    if (atomic_fetch_sub(&g_cache.page_refcount[page], 1) == 1 &&
+        atomic_load(&shard->io_waiters) > 0) {
+        pthread_mutex_lock(&shard->lock);
+        pthread_cond_broadcast(&shard->io_cond);
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+void cache_page_write_begin(page_id_t page) {
+    atomic_fetch_add_explicit(&g_cache.page_seq[page], 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+void cache_page_write_end(page_id_t page) {
+    atomic_fetch_add_explicit(&g_cache.page_seq[page], 1, memory_order_release);
+}
+
+void cache_lookaside_fill(int fd, off_t block_num, page_id_t page) {
+    uint64_t key = page_key(fd, block_num);
+    lookaside_entry_t *entry = lookaside_slot(key);
+
+    entry->instance = g_cache.instance;
+    entry->key = key;
+    entry->page = page;
+    entry->generation = atomic_load(&g_cache.page_generation[page]);
+}
+
+/*
+ * Hit trong lookaside L0: không cần hash hay epoch vì mảng page sống tới
+ * vtpc_destroy; generation và seq được kiểm tra trong cùng một cửa sổ seqlock.
+ */
+static bool lookaside_read(uint64_t key, size_t offset, void *dst, size_t len, unsigned hint) {
+    lookaside_entry_t *entry = lookaside_slot(key);
+
+    if (entry->instance != g_cache.instance || entry->key != key) {
+        return false;
+    }
+
+    page_id_t page = entry->page;
+    unsigned int seq = atomic_load_explicit(&g_cache.page_seq[page], memory_order_acquire);
+
+    if ((seq & 1) != 0 ||
+        atomic_load_explicit(&g_cache.page_generation[page], memory_order_relaxed) != entry->generation) {
+        return false;
+    }
+
+    memcpy(dst, (char *)cache_page_data(page) + offset, len);
+
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&g_cache.page_seq[page], memory_order_relaxed) != seq) {
+        return false;
+    }
+
+    cache_shard_t *shard = cache_page_shard(page);
+    policy_hit(shard, page, key, hint);
+    atomic_fetch_add_explicit(&shard->cache_hits, 1, memory_order_relaxed);
+
+    return true;
+}
+
+/*
+ * Đường hit không lock: dò bảng hash trong một epoch, copy dữ liệu rồi
+ * kiểm tra lại seq. Trả về false khi miss hoặc page bị ghi/evict đồng
+ * thời; caller khi đó dùng cache_get_page().
+ */
+bool cache_read_optimistic(int fd, off_t block_num, size_t offset, void *dst, size_t len,
+                           unsigned hint) {
+    uint64_t key = page_key(fd, block_num);
+
+    /*
+     * Policy cần cập nhật danh sách khi hit thì mọi hit phải đi qua lock,
+     * trừ hit đọc tiếp trong page của một lần quét vì chúng không chạm tới policy.
+     */
+    if (!g_cache.policy->lockless_hit && !(hint & ACCESS_REREAD)) {
+        return false;
+    }
+
+    if (lookaside_read(key, offset, dst, len, hint)) {
+        return true;
+    }
+
+    int slot = epoch_enter();
+    if (slot < 0) {
+        return false;
+    }
+
+    cache_shard_t *shard = cache_shard_of(fd, block_num);
+    page_hash_table_t *table = __atomic_load_n(&shard->hash_table, __ATOMIC_ACQUIRE);
+    page_id_t page = table_find(table, key, hash_key(key));
+    bool copied = false;
+
+    if (page != PAGE_NONE) {
+        unsigned int seq = atomic_load_explicit(&g_cache.page_seq[page], memory_order_acquire);
+
+        if ((seq & 1) == 0 && page_key_of(page) == key) {
+            memcpy(dst, (char *)cache_page_data(page) + offset, len);
+
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&g_cache.page_seq[page], memory_order_relaxed) == seq) {
+                policy_hit(shard, page, key, hint);
+                atomic_fetch_add_explicit(&shard->cache_hits, 1, memory_order_relaxed);
+                cache_lookaside_fill(fd, block_num, page);
+
+                copied = true;
+            }
+        }
+    }
+
+    epoch_exit(slot);
+
+    return copied;
 }
@@ -4,60 +4,284 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 
+#include "vtpc.h"
 #include "vtpc_internal.h"
 
-void *aligned_alloc_page(size_t page_size) {
-    void *ptr = NULL;
+static void *map_anonymous(size_t bytes, int extra_flags) {
+    void *ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
 
-    size_t alignment = page_size;
-    if (alignment < sizeof(void *)) {
-        alignment = sizeof(void *);
+    return (ptr == MAP_FAILED) ? NULL : ptr;
+}
+
+/*
+ * Một vùng mmap liên tục cho dữ liệu mọi page. Ưu tiên MAP_HUGETLB, sau đó
+ * THP (căn base theo 2 MB rồi madvise), cuối cùng là page 4K thường.
+ * Base luôn căn theo page của kernel, và page_size là bội số của 512 nên
+ * mọi buffer con đều thỏa điều kiện căn lề của O_DIRECT. Arena không bị
+ * chạm tới ở đây (MAP_NORESERVE), RAM chỉ được cấp khi page được dùng.
+ */
+void *arena_map(size_t bytes, bool huge_pages, size_t *mapped, int *backing) {
+    size_t huge_bytes = (bytes + VTPC_HUGE_PAGE_SIZE - 1) & ~(size_t)(VTPC_HUGE_PAGE_SIZE - 1);
+    void *ptr;
+
+    if (huge_pages) {
+        ptr = map_anonymous(huge_bytes, MAP_HUGETLB);
+        if (ptr != NULL) {
+            *mapped = huge_bytes;
+            *backing = VTPC_BACKING_HUGETLB;
+            return ptr;
+        }
+
+        /* Lấy dư 2 MB để cắt ra base căn theo huge page */
+        char *raw = map_anonymous(huge_bytes + VTPC_HUGE_PAGE_SIZE, MAP_NORESERVE);
+        if (raw != NULL) {
+            uintptr_t addr = (uintptr_t)raw;
+            uintptr_t aligned = (addr + VTPC_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(VTPC_HUGE_PAGE_SIZE - 1);
+            size_t head = aligned - addr;
+
+            if (head > 0) {
+                munmap(raw, head);
+            }
+            munmap((char *)aligned + huge_bytes, VTPC_HUGE_PAGE_SIZE - head);
+
+            *mapped = huge_bytes;
+            *backing = (madvise((void *)aligned, huge_bytes, MADV_HUGEPAGE) == 0)
+                ? VTPC_BACKING_THP : VTPC_BACKING_4K;
+            return (void *)aligned;
+        }
     }
 
-    if (posix_memalign(&ptr, alignment, page_size) != 0) {
+    ptr = map_anonymous(bytes, MAP_NORESERVE);
+    if (ptr == NULL) {
+        errno = ENOMEM;
         return NULL;
     }
 
-    memset(ptr, 0, page_size);
-
+    *mapped = bytes;
+    *backing = VTPC_BACKING_4K;
     return ptr;
 }
 
-void aligned_free_page(void *ptr) {
-    free(ptr);
+void arena_unmap(void *arena, size_t mapped) {
+    if (arena != NULL) {
+        munmap(arena, mapped);
+    }
 }
 
-ssize_t direct_read_block(int real_fd, off_t block_num, void *buf, size_t page_size) {
-    off_t offset = block_num * (off_t)page_size;
+/*
+ * Backend POSIX: handle là fd của kernel. preadv/pwritev không dùng offset
+ * chung của fd, an toàn khi nhiều thread cùng I/O.
+ */
+static int posix_start(unsigned latency_us, unsigned bandwidth_mb) {
+    (void)latency_us;
+    (void)bandwidth_mb;
+    return 0;
+}
+
+static void posix_stop(void) {
+}
+
+static int posix_open(const char *path, bool direct, bool *opened_direct) {
+    int fd = -1;
+
+    if (direct) {
+        fd = open(path, O_RDWR | O_CREAT | O_DIRECT, 0644);
+    }
+    *opened_direct = fd >= 0;
+    if (fd < 0) {
+        fd = open(path, O_RDWR | O_CREAT, 0644);
+    }
+
+    return fd;
+}
 
-    if (lseek(real_fd, offset, SEEK_SET) == (off_t)-1) {
+static off_t posix_size(int handle) {
+    struct stat st;
+
+    if (fstat(handle, &st) < 0) {
         return -1;
     }
 
-    ssize_t bytes_read = read(real_fd, buf, page_size);
+    return st.st_size;
+}
+
+const storage_backend_t storage_posix = {
+    .name = "posix",
+    .kernel_fd = true,
+    .start = posix_start,
+    .stop = posix_stop,
+    .open = posix_open,
+    .close = close,
+    .readv = preadv,
+    .writev = pwritev,
+    .size = posix_size,
+    .sync = fsync,
+};
+
+int direct_open(const char *path, bool direct, bool *opened_direct) {
+    return g_cache.storage->open(path, direct, opened_direct);
+}
+
+int direct_close(int real_fd) {
+    return g_cache.storage->close(real_fd);
+}
 
-    return bytes_read;
+int direct_sync(int real_fd) {
+    return g_cache.storage->sync(real_fd);
+}
+
+ssize_t direct_read_block(int real_fd, off_t block_num, void *buf, size_t page_size) {
+    struct iovec iov = { .iov_base = buf, .iov_len = page_size };
+
+    atomic_fetch_add(&g_cache.device_reads, 1);
+    return g_cache.storage->readv(real_fd, &iov, 1, block_num * (off_t)page_size);
 }
 
 ssize_t direct_write_block(int real_fd, off_t block_num, const void *buf, size_t page_size) {
-    off_t offset = block_num * (off_t)page_size;
+    struct iovec iov = { .iov_base = (void *)buf, .iov_len = page_size };
 
-    if (lseek(real_fd, offset, SEEK_SET) == (off_t)-1) {
-        return -1;
+    atomic_fetch_add(&g_cache.device_writes, 1);
+    return g_cache.storage->writev(real_fd, &iov, 1, block_num * (off_t)page_size);
+}
+
+/* Một lời gọi cho nhiều block liên tiếp; có thể trả về ít hơn ở cuối file */
+ssize_t direct_read_blocks(int real_fd, off_t block_num, size_t nblocks, void *buf, size_t page_size) {
+    struct iovec iov = { .iov_base = buf, .iov_len = nblocks * page_size };
+
+    atomic_fetch_add(&g_cache.device_reads, 1);
+    return g_cache.storage->readv(real_fd, &iov, 1, block_num * (off_t)page_size);
+}
+
+/* Như direct_read_blocks() nhưng mỗi block vào một buffer riêng; nblocks <= VTPC_CLUSTER_MAX */
+ssize_t direct_read_vec(int real_fd, off_t block_num, void *const *bufs, size_t nblocks,
+                        size_t page_size) {
+    struct iovec iov[VTPC_CLUSTER_MAX];
+
+    for (size_t i = 0; i < nblocks; i++) {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = page_size;
     }
 
-    ssize_t bytes_written = write(real_fd, buf, page_size);
+    atomic_fetch_add(&g_cache.device_reads, 1);
+    return g_cache.storage->readv(real_fd, iov, (int)nblocks, block_num * (off_t)page_size);
+}
+
+ssize_t direct_write_blocks(int real_fd, off_t block_num, size_t nblocks, const void *buf,
+                            size_t page_size) {
+    struct iovec iov = { .iov_base = (void *)buf, .iov_len = nblocks * page_size };
 
-    return bytes_written;
+    atomic_fetch_add(&g_cache.device_writes, 1);
+    return g_cache.storage->writev(real_fd, &iov, 1, block_num * (off_t)page_size);
 }
 
-off_t get_file_size(int real_fd) {
-    struct stat st;
+/*
+ * Chạy n yêu cầu; kết quả của từng yêu cầu nằm trong result/error. Lô nhiều
+ * yêu cầu đi qua io_uring khi có (một syscall cho cả lô), còn lại làm tuần tự
+ * qua backend lưu trữ.
+ */
+void direct_submit(io_req_t *reqs, size_t n) {
+    const storage_backend_t *storage = g_cache.storage;
+
+    for (size_t i = 0; i < n; i++) {
+        atomic_fetch_add(reqs[i].write ? &g_cache.device_writes : &g_cache.device_reads, 1);
+    }
+
+    if (n > 1 && g_cache.io_backend == VTPC_IO_URING && uring_submit(reqs, n) == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        io_req_t *req = &reqs[i];
+
+        req->result = req->write ? storage->writev(req->real_fd, req->iov, req->iovcnt, req->offset)
+                                 : storage->readv(req->real_fd, req->iov, req->iovcnt, req->offset);
+        req->error = (req->result < 0) ? errno : 0;
+    }
+}
+
+void io_batch_init(io_batch_t *io) {
+    io->nreq = 0;
+    io->niov = 0;
+    io->end = -1;
+    io->error = 0;
+}
+
+void io_batch_add(io_batch_t *io, int real_fd, bool write, off_t offset, void *buf, size_t len) {
+    io_req_t *last = (io->nreq > 0) ? &io->reqs[io->nreq - 1] : NULL;
 
-    if (fstat(real_fd, &st) < 0) {
+    if (last != NULL && last->real_fd == real_fd && last->write == write && io->end == offset) {
+        struct iovec *tail = &io->iov[io->niov - 1];
+
+        if ((char *)tail->iov_base + tail->iov_len == (char *)buf) {
+            tail->iov_len += len;
+            io->expected[io->nreq - 1] += len;
+            io->end += (off_t)len;
+            return;
+        }
+        if (io->niov < VTPC_IO_BATCH * 4) {
+            io->iov[io->niov].iov_base = buf;
+            io->iov[io->niov].iov_len = len;
+            io->niov++;
+            last->iovcnt++;
+            io->expected[io->nreq - 1] += len;
+            io->end += (off_t)len;
+            return;
+        }
+    }
+
+    if (io->nreq == VTPC_IO_BATCH || io->niov == VTPC_IO_BATCH * 4) {
+        io_batch_submit(io);
+    }
+
+    io_req_t *req = &io->reqs[io->nreq];
+
+    req->real_fd = real_fd;
+    req->write = write;
+    req->offset = offset;
+    req->iov = &io->iov[io->niov];
+    req->iovcnt = 1;
+    io->iov[io->niov].iov_base = buf;
+    io->iov[io->niov].iov_len = len;
+    io->expected[io->nreq] = len;
+    io->niov++;
+    io->nreq++;
+    io->end = offset + (off_t)len;
+}
+
+/*
+ * Gửi các yêu cầu còn lại. Trả về -1 với errno của lỗi đầu tiên nếu có yêu
+ * cầu nào lỗi kể từ io_batch_init(); ghi thiếu cũng là lỗi (EIO), đọc
+ * thiếu ở cuối file thì không.
+ */
+int io_batch_submit(io_batch_t *io) {
+    direct_submit(io->reqs, io->nreq);
+
+    for (size_t i = 0; i < io->nreq && io->error == 0; i++) {
+        io_req_t *req = &io->reqs[i];
+
+        if (req->result < 0) {
+            io->error = req->error;
+        } else if (req->write && (size_t)req->result != io->expected[i]) {
+            io->error = EIO;
+        }
+    }
+
+    io->nreq = 0;
+    io->niov = 0;
+    io->end = -1;
+
+    if (io->error != 0) {
+        errno = io->error;
         return -1;
     }
 
-    return st.st_size;
+    return 0;
+}
+
+off_t get_file_size(int real_fd) {
+    return g_cache.storage->size(real_fd);
 }
@@ -0,0 +1,92 @@
+/**
+ * epoch.c - Epoch-based reclamation cho đường đọc không lock
+ *
+ * Reader gọi epoch_enter()/epoch_exit() quanh phần duyệt cấu trúc chung.
+ * Writer gỡ một đối tượng ra khỏi cấu trúc rồi gọi epoch_synchronize()
+ * trước khi tái sử dụng nó: hàm này chờ mọi reader đã vào từ epoch cũ.
+ */
+
+#include <sched.h>
+#include <pthread.h>
+
+#include "vtpc_internal.h"
+
+typedef struct {
+    atomic_ulong epoch;     /* 0 = không hoạt động */
+    atomic_bool owned;
+} __attribute__((aligned(64))) epoch_slot_t;
+
+static epoch_slot_t g_slots[VTPC_MAX_READERS];
+static atomic_ulong g_global_epoch = 1;
+static atomic_int g_max_slot = 0;
+
+static pthread_once_t g_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_slot_key;
+static _Thread_local int tls_slot = -1;
+
+static void release_slot(void *arg) {
+    epoch_slot_t *slot = (epoch_slot_t *)arg;
+
+    atomic_store(&slot->epoch, 0);
+    atomic_store(&slot->owned, false);
+}
+
+static void make_key(void) {
+    pthread_key_create(&g_slot_key, release_slot);
+}
+
+static int claim_slot(void) {
+    pthread_once(&g_key_once, make_key);
+
+    for (int i = 0; i < VTPC_MAX_READERS; i++) {
+        bool expected = false;
+
+        if (atomic_compare_exchange_strong(&g_slots[i].owned, &expected, true)) {
+            int max = atomic_load(&g_max_slot);
+            while (max < i + 1 &&
+                   !atomic_compare_exchange_weak(&g_max_slot, &max, i + 1)) {
+            }
+
+            pthread_setspecific(g_slot_key, &g_slots[i]);
+            tls_slot = i;
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int epoch_enter(void) {
+    int slot = tls_slot;
+
+    if (slot < 0) {
+        slot = claim_slot();
+        if (slot < 0) {
+            return -1;
+        }
+    }
+
+    atomic_store(&g_slots[slot].epoch, atomic_load(&g_global_epoch));
+
+    return slot;
+}
+
+void epoch_exit(int slot) {
+    atomic_store_explicit(&g_slots[slot].epoch, 0, memory_order_release);
+}
+
+void epoch_synchronize(void) {
+    unsigned long target = atomic_fetch_add(&g_global_epoch, 1) + 1;
+    int max = atomic_load(&g_max_slot);
+
+    for (int i = 0; i < max; i++) {
+        for (;;) {
+            unsigned long e = atomic_load(&g_slots[i].epoch);
+
+            if (e == 0 || e >= target) {
+                break;
+            }
+            sched_yield();
+        }
+    }
+}
@@ -0,0 +1,166 @@
+/**
+ * ghost.c - Ghost list: key của page vừa bị evict, không có dữ liệu
+ *
+ * Các list dùng chung một pool node và một bảng key -> node (dò tuyến
+ * tính, xóa bằng dời lùi), nên tra cứu key thuộc list nào là O(1). Pool
+ * và bảng lấy từ calloc/malloc và không bị ghi lúc init, như page của cache.
+ */
+
+#include <stdlib.h>
+
+#include "vtpc_internal.h"
+
+static size_t map_home(const ghost_table_t *g, uint64_t key) {
+    return (size_t)hash_key(key) & g->map_mask;
+}
+
+static uint32_t map_find(const ghost_table_t *g, uint64_t key) {
+    for (size_t i = map_home(g, key); g->map[i] != 0; i = (i + 1) & g->map_mask) {
+        if (g->nodes[g->map[i] - 1].key == key) {
+            return g->map[i] - 1;
+        }
+    }
+    return GHOST_NONE;
+}
+
+static void map_insert(ghost_table_t *g, uint64_t key, uint32_t node) {
+    size_t i = map_home(g, key);
+
+    while (g->map[i] != 0) {
+        i = (i + 1) & g->map_mask;
+    }
+    g->map[i] = node + 1;
+}
+
+static void map_delete(ghost_table_t *g, uint64_t key) {
+    size_t i = map_home(g, key);
+
+    while (g->nodes[g->map[i] - 1].key != key) {
+        i = (i + 1) & g->map_mask;
+    }
+
+    for (size_t j = (i + 1) & g->map_mask; g->map[j] != 0; j = (j + 1) & g->map_mask) {
+        size_t k = map_home(g, g->nodes[g->map[j] - 1].key);
+
+        /* Phần tử ở j được phép dời về i nếu home của nó không nằm trong (i, j] */
+        if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+            g->map[i] = g->map[j];
+            i = j;
+        }
+    }
+
+    g->map[i] = 0;
+}
+
+static void ghost_unlink(ghost_table_t *g, uint32_t node) {
+    ghost_list_t *list = g->node_list[node];
+    ghost_node_t *n = &g->nodes[node];
+
+    if (n->prev != GHOST_NONE) {
+        g->nodes[n->prev].next = n->next;
+    } else {
+        list->head = n->next;
+    }
+
+    if (n->next != GHOST_NONE) {
+        g->nodes[n->next].prev = n->prev;
+    } else {
+        list->tail = n->prev;
+    }
+
+    list->count--;
+
+    map_delete(g, n->key);
+    g->node_list[node] = NULL;
+    n->next = g->free_node;
+    g->free_node = node;
+}
+
+int ghost_table_init(ghost_table_t *g, size_t capacity) {
+    size_t map_size = 16;
+    while (map_size < capacity * 2) {
+        map_size *= 2;
+    }
+
+    g->capacity = capacity;
+    g->nodes = malloc(capacity * sizeof(ghost_node_t));
+    g->node_list = calloc(capacity, sizeof(ghost_list_t *));
+    g->map = calloc(map_size, sizeof(uint32_t));
+    g->map_mask = map_size - 1;
+
+    if (g->nodes == NULL || g->node_list == NULL || g->map == NULL) {
+        ghost_table_destroy(g);
+        return -1;
+    }
+
+    /* Node được cấp dần qua fresh_node, init không chạm tới pool */
+    g->free_node = GHOST_NONE;
+    g->fresh_node = 0;
+
+    return 0;
+}
+
+void ghost_table_destroy(ghost_table_t *g) {
+    free(g->nodes);
+    free(g->node_list);
+    free(g->map);
+
+    g->nodes = NULL;
+    g->node_list = NULL;
+    g->map = NULL;
+}
+
+void ghost_list_init(ghost_list_t *list) {
+    list->head = GHOST_NONE;
+    list->tail = GHOST_NONE;
+    list->count = 0;
+}
+
+ghost_list_t *ghost_find(const ghost_table_t *g, uint64_t key) {
+    uint32_t node = map_find(g, key);
+
+    return (node == GHOST_NONE) ? NULL : g->node_list[node];
+}
+
+void ghost_remove(ghost_table_t *g, uint64_t key) {
+    uint32_t node = map_find(g, key);
+
+    if (node != GHOST_NONE) {
+        ghost_unlink(g, node);
+    }
+}
+
+void ghost_drop_oldest(ghost_table_t *g, ghost_list_t *list) {
+    if (list->head != GHOST_NONE) {
+        ghost_unlink(g, list->head);
+    }
+}
+
+/* Caller phải bảo đảm tổng số key trong mọi list nhỏ hơn capacity */
+void ghost_push(ghost_table_t *g, ghost_list_t *list, uint64_t key) {
+    uint32_t node = g->free_node;
+
+    if (node != GHOST_NONE) {
+        g->free_node = g->nodes[node].next;
+    } else {
+        node = g->fresh_node++;
+    }
+
+    ghost_node_t *n = &g->nodes[node];
+
+    n->key = key;
+    n->next = GHOST_NONE;
+    n->prev = list->tail;
+
+    if (list->tail != GHOST_NONE) {
+        g->nodes[list->tail].next = node;
+    } else {
+        list->head = node;
+    }
+
+    list->tail = node;
+    list->count++;
+    g->node_list[node] = list;
+
+    map_insert(g, key, node);
+}
@@ -0,0 +1,192 @@
+/**
+ * pin.c - Truy cập trực tiếp page trong cache
+ *
+ * vtpc_pin() giữ page chứa offset (refcount > 0, nên policy không chọn nó
+ * làm victim) và trả về con trỏ vào dữ liệu của page, không chép. Page
+ * được giữ tới vtpc_unpin(); trong lúc đó file không đóng được và ghi lớn
+ * không đi thẳng xuống thiết bị, vì cả hai đều bỏ page khỏi cache.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "vtpc.h"
+#include "vtpc_internal.h"
+
+int pin_table_init(void) {
+    pin_table_t *pt = &g_cache.pins;
+
+    pt->capacity = g_cache.cache_size / VTPC_PIN_CACHE_FRACTION;
+    if (pt->capacity > VTPC_MAX_PINS) {
+        pt->capacity = VTPC_MAX_PINS;
+    }
+    if (pt->capacity == 0) {
+        pt->capacity = 1;
+    }
+
+    pt->slots = calloc(pt->capacity, sizeof(pin_t));
+    pt->shard_pins = calloc(g_cache.num_shards, sizeof(uint32_t));
+    if (pt->slots == NULL || pt->shard_pins == NULL) {
+        free(pt->slots);
+        free(pt->shard_pins);
+        pt->slots = NULL;
+        pt->shard_pins = NULL;
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (size_t i = 0; i < pt->capacity; i++) {
+        pt->slots[i].page = PAGE_NONE;
+        pt->slots[i].next_free = (i + 1 < pt->capacity) ? (uint32_t)(i + 1) : UINT32_MAX;
+    }
+    pt->free_head = 0;
+    pt->active = 0;
+    pt->total = 0;
+
+    if (pthread_mutex_init(&pt->lock, NULL) != 0) {
+        free(pt->slots);
+        free(pt->shard_pins);
+        pt->slots = NULL;
+        pt->shard_pins = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Pin còn giữ lúc vtpc_destroy() bị bỏ cùng cache */
+void pin_table_destroy(void) {
+    pin_table_t *pt = &g_cache.pins;
+
+    pthread_mutex_destroy(&pt->lock);
+    free(pt->slots);
+    free(pt->shard_pins);
+    pt->slots = NULL;
+    pt->shard_pins = NULL;
+}
+
+/* Shard đã có đủ pin thì một miss vào nó có thể không còn victim */
+static uint32_t shard_pin_limit(const cache_shard_t *shard) {
+    size_t limit = shard->page_count / VTPC_PIN_CACHE_FRACTION;
+
+    return limit > 0 ? (uint32_t)limit : 1;
+}
+
+int vtpc_pin(int fd, off_t offset, void **ptr, size_t *len) {
+    if (!g_cache.initialized || ptr == NULL || len == NULL || offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    file_entry_t *file = get_file_entry(fd);
+    if (file == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    pthread_mutex_lock(&file->lock);
+
+    if (!file->in_use) {
+        pthread_mutex_unlock(&file->lock);
+        errno = EBADF;
+        return -1;
+    }
+    if (offset >= file->file_size) {
+        pthread_mutex_unlock(&file->lock);
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t page_size = g_cache.page_size;
+    off_t block_num = offset / (off_t)page_size;
+    size_t in_page = (size_t)(offset % (off_t)page_size);
+    size_t avail = page_size - in_page;
+
+    if ((off_t)avail > file->file_size - offset) {
+        avail = (size_t)(file->file_size - offset);
+    }
+
+    page_id_t page = cache_get_page(fd, block_num, true, 0);
+    if (page == PAGE_NONE) {
+        pthread_mutex_unlock(&file->lock);
+        return -1;
+    }
+
+    pin_table_t *pt = &g_cache.pins;
+    cache_shard_t *shard = cache_page_shard(page);
+    size_t shard_idx = (size_t)(shard - g_cache.shards);
+
+    pthread_mutex_lock(&pt->lock);
+
+    uint32_t slot = pt->free_head;
+    if (slot == UINT32_MAX || pt->shard_pins[shard_idx] >= shard_pin_limit(shard)) {
+        pthread_mutex_unlock(&pt->lock);
+        pthread_mutex_unlock(&file->lock);
+        cache_put_page(page, false);
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    pt->free_head = pt->slots[slot].next_free;
+    pt->slots[slot].page = page;
+    pt->slots[slot].fd = fd;
+    pt->slots[slot].offset = (uint32_t)in_page;
+    pt->slots[slot].len = (uint32_t)avail;
+    pt->shard_pins[shard_idx]++;
+    pt->active++;
+    pt->total++;
+
+    pthread_mutex_unlock(&pt->lock);
+
+    atomic_fetch_add(&file->pins, 1);
+
+    pthread_mutex_unlock(&file->lock);
+
+    *ptr = (char *)cache_page_data(page) + in_page;
+    *len = avail;
+
+    return (int)slot;
+}
+
+/*
+ * dirty != 0: caller đã sửa dải được trao, dải đó thành dirty như sau
+ * vtpc_write(). Kích thước file không đổi.
+ */
+int vtpc_unpin(int handle, int dirty) {
+    pin_table_t *pt = &g_cache.pins;
+
+    if (!g_cache.initialized || handle < 0 || (size_t)handle >= pt->capacity) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    pthread_mutex_lock(&pt->lock);
+
+    pin_t pin = pt->slots[handle];
+    if (pin.page == PAGE_NONE) {
+        pthread_mutex_unlock(&pt->lock);
+        errno = EINVAL;
+        return -1;
+    }
+
+    pt->slots[handle].page = PAGE_NONE;
+    pt->slots[handle].next_free = pt->free_head;
+    pt->free_head = (uint32_t)handle;
+    pt->shard_pins[cache_page_shard(pin.page) - g_cache.shards]--;
+    pt->active--;
+
+    pthread_mutex_unlock(&pt->lock);
+
+    if (dirty) {
+        /* Lượt đọc không lock đang chép page sẽ thấy seq đổi và đọc lại */
+        cache_page_write_begin(pin.page);
+        cache_page_write_end(pin.page);
+        cache_put_page_dirty(pin.page, pin.offset, pin.len);
+    } else {
+        cache_put_page(pin.page, false);
+    }
+
+    atomic_fetch_sub(&get_file_entry(pin.fd)->pins, 1);
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+/**
+ * policy.c - Second Chance dạng CLOCK trên mảng page của shard
+ *
+ * Reference bit và bit "đang thường trú" được gói trong hai bitmap theo vị
+ * trí page trong shard. Kim đồng hồ quét từng word 64 page bằng ctz: page
+ * thường trú chưa được tham chiếu là victim, các page đã đi qua bị xóa
+ * reference bit. Hit chỉ bật một bit bằng atomic OR, làm được không lock.
+ *
+ * Page cold (nạp khi đọc tuần tự) được đánh dấu trong bitmap thứ ba và bị
+ * evict trước mọi page khác, nên một lần quét file chỉ quay vòng trong vài
+ * slot thay vì đẩy kim đi qua và xóa reference bit của working set.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "vtpc_internal.h"
+
+typedef struct {
+    uint64_t *resident;
+    uint64_t *referenced;   /* bật không lock bởi hit, dùng __atomic */
+    uint64_t *cold;
+    size_t count;
+    size_t cold_count;
+    size_t hand;            /* vị trí page trong shard */
+    size_t cold_hand;
+} clock_state_t;
+
+static clock_state_t *clock_state(cache_shard_t *shard) {
+    return shard->policy_state;
+}
+
+static void sc_destroy(cache_shard_t *shard) {
+    clock_state_t *st = clock_state(shard);
+
+    if (st != NULL) {
+        free(st->resident);
+        free(st->referenced);
+        free(st->cold);
+        free(st);
+    }
+    shard->policy_state = NULL;
+}
+
+static int sc_init(cache_shard_t *shard) {
+    clock_state_t *st = calloc(1, sizeof(clock_state_t));
+    if (st == NULL) {
+        return -1;
+    }
+
+    size_t words = (shard->page_count + 63) / 64;
+
+    st->resident = calloc(words, sizeof(uint64_t));
+    st->referenced = calloc(words, sizeof(uint64_t));
+    st->cold = calloc(words, sizeof(uint64_t));
+    shard->policy_state = st;
+
+    if (st->resident == NULL || st->referenced == NULL || st->cold == NULL) {
+        sc_destroy(shard);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Chỉ ghi khi bit chưa bật để khỏi làm bẩn cache line */
+static void sc_on_hit(cache_shard_t *shard, page_id_t page) {
+    clock_state_t *st = clock_state(shard);
+    size_t pos = page - shard->first_page;
+    uint64_t mask = 1ULL << (pos % 64);
+    uint64_t *word = &st->referenced[pos / 64];
+
+    if ((__atomic_load_n(word, __ATOMIC_RELAXED) & mask) == 0) {
+        __atomic_fetch_or(word, mask, __ATOMIC_RELAXED);
+    }
+}
+
+static void sc_on_insert(cache_shard_t *shard, page_id_t page, bool cold) {
+    clock_state_t *st = clock_state(shard);
+    size_t pos = page - shard->first_page;
+    uint64_t mask = 1ULL << (pos % 64);
+
+    st->resident[pos / 64] |= mask;
+    if (cold) {
+        /* Hit không lock tới muộn có thể bật lại bit sau sc_on_remove() của chủ cũ */
+        __atomic_fetch_and(&st->referenced[pos / 64], ~mask, __ATOMIC_RELAXED);
+        st->cold[pos / 64] |= mask;
+        st->cold_count++;
+    } else {
+        __atomic_fetch_or(&st->referenced[pos / 64], mask, __ATOMIC_RELAXED);
+    }
+    st->count++;
+}
+
+/*
+ * Tìm page cold chưa được hit. Page cold đã được hit (đọc ngẫu nhiên sau
+ * lần quét) trở thành page thường; page đọc trước chưa được đọc thì chưa
+ * bị lấy ở đây.
+ */
+static page_id_t sc_cold_victim(cache_shard_t *shard, clock_state_t *st) {
+    size_t words = (shard->page_count + 63) / 64;
+
+    for (size_t i = 0; i <= words && st->cold_count > 0; i++) {
+        size_t w = (st->cold_hand / 64 + i) % words;
+        uint64_t referenced = __atomic_load_n(&st->referenced[w], __ATOMIC_RELAXED);
+        uint64_t promoted = st->cold[w] & referenced;
+
+        if (promoted != 0) {
+            st->cold[w] &= ~promoted;
+            st->cold_count -= (size_t)__builtin_popcountll(promoted);
+        }
+
+        for (uint64_t cand = st->cold[w]; cand != 0; cand &= cand - 1) {
+            unsigned b = (unsigned)__builtin_ctzll(cand);
+            page_id_t page = shard->first_page + (page_id_t)(w * 64 + b);
+
+            if (page_evictable(page) && !page_test(page, PAGE_PREFETCHED)) {
+                st->cold_hand = w * 64;
+                return page;
+            }
+        }
+    }
+
+    return PAGE_NONE;
+}
+
+static page_id_t sc_choose_victim(cache_shard_t *shard) {
+    clock_state_t *st = clock_state(shard);
+
+    if (st->count == 0) {
+        errno = ENOMEM;
+        return PAGE_NONE;
+    }
+
+    if (st->cold_count > 0) {
+        page_id_t page = sc_cold_victim(shard, st);
+        if (page != PAGE_NONE) {
+            return page;
+        }
+    }
+
+    /*
+     * Vòng đầu xóa reference bit; sau một vòng đầy đủ thì bỏ qua bit (hit
+     * đồng thời có thể bật lại liên tục), chỉ page bận/bị pin mới bị bỏ qua.
+     */
+    size_t scanned = 0;
+    size_t limit = 2 * shard->page_count + 64;
+
+    while (scanned < limit) {
+        size_t w = st->hand / 64;
+        unsigned bit = st->hand % 64;
+        uint64_t ahead = ~0ULL << bit;
+        uint64_t resident = st->resident[w] & ahead;
+        uint64_t cand = resident;
+
+        if (scanned < shard->page_count) {
+            cand &= ~__atomic_load_n(&st->referenced[w], __ATOMIC_RELAXED);
+        }
+
+        while (cand != 0) {
+            unsigned b = (unsigned)__builtin_ctzll(cand);
+            page_id_t page = shard->first_page + (page_id_t)(w * 64 + b);
+
+            if (page_evictable(page)) {
+                uint64_t passed = resident & ((1ULL << b) - 1);
+
+                __atomic_fetch_and(&st->referenced[w], ~passed, __ATOMIC_RELAXED);
+                st->hand = (w * 64 + b + 1 < shard->page_count) ? w * 64 + b + 1 : 0;
+                return page;
+            }
+            cand &= cand - 1;
+        }
+
+        __atomic_fetch_and(&st->referenced[w], ~resident, __ATOMIC_RELAXED);
+        scanned += 64 - bit;
+        st->hand = ((w + 1) * 64 < shard->page_count) ? (w + 1) * 64 : 0;
+    }
+
+    errno = EBUSY;
+    return PAGE_NONE;
+}
+
+static void sc_on_remove(cache_shard_t *shard, page_id_t page, bool evicted) {
+    clock_state_t *st = clock_state(shard);
+    size_t pos = page - shard->first_page;
+    uint64_t mask = 1ULL << (pos % 64);
+
+    (void)evicted;
+
+    st->resident[pos / 64] &= ~mask;
+    __atomic_fetch_and(&st->referenced[pos / 64], ~mask, __ATOMIC_RELAXED);
+    if (st->cold[pos / 64] & mask) {
+        st->cold[pos / 64] &= ~mask;
+        st->cold_count--;
+    }
+    st->count--;
+}
+
+const cache_policy_t policy_second_chance = {
+    .name = "Second Chance",
+    .lockless_hit = true,
+    .init = sc_init,
+    .destroy = sc_destroy,
+    .on_hit = sc_on_hit,
+    .on_insert = sc_on_insert,
+    .choose_victim = sc_choose_victim,
+    .on_remove = sc_on_remove,
+};
@@ -0,0 +1,171 @@
+/**
+ * policy_arc.c - Adaptive Replacement Cache (Megiddo & Modha)
+ *
+ * T1 chứa page mới được dùng một lần, T2 chứa page được dùng từ hai lần
+ * trở lên (PAGE_POLICY0). B1/B2 là ghost list chỉ giữ key của page vừa bị
+ * evict khỏi T1/T2; miss trúng ghost list sẽ dịch mục tiêu p của T1.
+ * Hit phải chuyển page giữa các list nên ARC không dùng đường đọc không lock.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "vtpc_internal.h"
+
+typedef struct {
+    page_queue_t t1;
+    page_queue_t t2;
+    ghost_list_t b1;
+    ghost_list_t b2;
+    ghost_table_t ghosts;   /* c node, đủ cho |B1| + |B2| <= c */
+
+    size_t c;
+    size_t p;           /* kích thước mục tiêu của T1 */
+} arc_state_t;
+
+static arc_state_t *arc_state(cache_shard_t *shard) {
+    return shard->policy_state;
+}
+
+static void arc_destroy(cache_shard_t *shard) {
+    arc_state_t *st = arc_state(shard);
+
+    if (st != NULL) {
+        ghost_table_destroy(&st->ghosts);
+        free(st);
+    }
+    shard->policy_state = NULL;
+}
+
+static int arc_init(cache_shard_t *shard) {
+    arc_state_t *st = calloc(1, sizeof(arc_state_t));
+    if (st == NULL) {
+        return -1;
+    }
+
+    st->c = shard->page_count;
+
+    if (ghost_table_init(&st->ghosts, st->c) < 0) {
+        free(st);
+        return -1;
+    }
+
+    queue_init(&st->t1);
+    queue_init(&st->t2);
+    ghost_list_init(&st->b1);
+    ghost_list_init(&st->b2);
+
+    shard->policy_state = st;
+
+    return 0;
+}
+
+static void arc_on_hit(cache_shard_t *shard, page_id_t page) {
+    arc_state_t *st = arc_state(shard);
+
+    if (page_test(page, PAGE_POLICY0)) {
+        queue_move_to_back(&st->t2, page);
+    } else {
+        queue_remove(&st->t1, page);
+        queue_push_back(&st->t2, page);
+        page_set(page, PAGE_POLICY0);
+    }
+}
+
+static void arc_on_insert(cache_shard_t *shard, page_id_t page, bool cold) {
+    arc_state_t *st = arc_state(shard);
+    uint64_t key = page_key_of(page);
+    ghost_list_t *ghost = ghost_find(&st->ghosts, key);
+
+    /*
+     * Page cold vào đầu LRU của T1 (page đọc trước thì vào cuối như thường
+     * để còn chờ được đọc); ghost trúng không được tính để dịch p.
+     */
+    if (cold) {
+        if (ghost != NULL) {
+            ghost_remove(&st->ghosts, key);
+        }
+        if (page_test(page, PAGE_PREFETCHED)) {
+            queue_push_back(&st->t1, page);
+        } else {
+            queue_push_front(&st->t1, page);
+        }
+        return;
+    }
+
+    if (ghost == NULL) {
+        queue_push_back(&st->t1, page);
+        return;
+    }
+
+    /* Miss trúng ghost: list đó lẽ ra nên lớn hơn */
+    if (ghost == &st->b1) {
+        size_t delta = (st->b2.count > st->b1.count) ? st->b2.count / st->b1.count : 1;
+        st->p = (st->p + delta < st->c) ? st->p + delta : st->c;
+    } else {
+        size_t delta = (st->b1.count > st->b2.count) ? st->b1.count / st->b2.count : 1;
+        st->p = (st->p > delta) ? st->p - delta : 0;
+    }
+
+    ghost_remove(&st->ghosts, key);
+    queue_push_back(&st->t2, page);
+    page_set(page, PAGE_POLICY0);
+}
+
+static page_id_t lru_evictable(const page_queue_t *q) {
+    for (page_id_t page = q->head; page != PAGE_NONE; page = g_cache.page_links[page].next) {
+        if (page_evictable(page)) {
+            return page;
+        }
+    }
+    return PAGE_NONE;
+}
+
+static page_id_t arc_choose_victim(cache_shard_t *shard) {
+    arc_state_t *st = arc_state(shard);
+    bool from_t1 = st->t1.count > 0 && (st->t1.count > st->p || st->t2.count == 0);
+
+    page_id_t page = lru_evictable(from_t1 ? &st->t1 : &st->t2);
+    if (page == PAGE_NONE) {
+        page = lru_evictable(from_t1 ? &st->t2 : &st->t1);
+    }
+
+    if (page == PAGE_NONE) {
+        errno = (st->t1.count + st->t2.count > 0) ? EBUSY : ENOMEM;
+    }
+
+    return page;
+}
+
+static void arc_on_remove(cache_shard_t *shard, page_id_t page, bool evicted) {
+    arc_state_t *st = arc_state(shard);
+    bool in_t2 = page_test(page, PAGE_POLICY0);
+
+    queue_remove(in_t2 ? &st->t2 : &st->t1, page);
+    page_clear(page, PAGE_POLICY0);
+
+    if (!evicted) {
+        return;
+    }
+
+    /* Giữ |T1| + |B1| <= c và |B1| + |B2| <= c */
+    if (!in_t2 && st->t1.count + st->b1.count >= st->c) {
+        ghost_drop_oldest(&st->ghosts, &st->b1);
+    }
+    if (st->b1.count + st->b2.count >= st->c) {
+        ghost_drop_oldest(&st->ghosts, st->b2.count > 0 ? &st->b2 : &st->b1);
+    }
+
+    ghost_push(&st->ghosts, in_t2 ? &st->b2 : &st->b1, page_key_of(page));
+}
+
+const cache_policy_t policy_arc = {
+    .name = "ARC",
+    .lockless_hit = false,
+    .init = arc_init,
+    .destroy = arc_destroy,
+    .on_hit = arc_on_hit,
+    .on_insert = arc_on_insert,
+    .choose_victim = arc_choose_victim,
+    .on_remove = arc_on_remove,
+};
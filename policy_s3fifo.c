@@ -0,0 +1,175 @@
+/**
+ * policy_s3fifo.c - S3-FIFO (Yang et al., SOSP'23)
+ *
+ * Page mới vào FIFO nhỏ S (~10% cache). Khi rời S, page đã được đọc lại
+ * thì sang FIFO chính M, còn lại bị evict và key vào ghost FIFO G; miss
+ * trúng G thì vào thẳng M. Trong M, page có tần suất > 0 được giảm tần
+ * suất và cho thêm một vòng. Hit chỉ tăng bộ đếm 2 bit trong page_flags
+ * bằng CAS, nên dùng được trên đường đọc không lock.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "vtpc_internal.h"
+
+#define S3_IN_MAIN    PAGE_POLICY0
+#define S3_FREQ_SHIFT 6
+#define S3_FREQ_ONE   PAGE_POLICY1
+#define S3_FREQ_MASK  (PAGE_POLICY1 | PAGE_POLICY2)
+
+typedef struct {
+    page_queue_t small;
+    page_queue_t main;
+    ghost_list_t ghost;
+    ghost_table_t ghosts;
+    size_t small_target;
+} s3fifo_state_t;
+
+static s3fifo_state_t *s3_state(cache_shard_t *shard) {
+    return shard->policy_state;
+}
+
+static unsigned s3_freq(page_id_t page) {
+    return (page_flags(page) & S3_FREQ_MASK) >> S3_FREQ_SHIFT;
+}
+
+static void s3_destroy(cache_shard_t *shard) {
+    s3fifo_state_t *st = s3_state(shard);
+
+    if (st != NULL) {
+        ghost_table_destroy(&st->ghosts);
+        free(st);
+    }
+    shard->policy_state = NULL;
+}
+
+static int s3_init(cache_shard_t *shard) {
+    s3fifo_state_t *st = calloc(1, sizeof(s3fifo_state_t));
+    if (st == NULL) {
+        return -1;
+    }
+
+    /* G nhớ khoảng số key bằng kích thước M */
+    if (ghost_table_init(&st->ghosts, shard->page_count) < 0) {
+        free(st);
+        return -1;
+    }
+
+    queue_init(&st->small);
+    queue_init(&st->main);
+    ghost_list_init(&st->ghost);
+
+    st->small_target = shard->page_count / 10;
+    if (st->small_target == 0) {
+        st->small_target = 1;
+    }
+
+    shard->policy_state = st;
+
+    return 0;
+}
+
+/* Không giữ lock: tăng tần suất, bão hòa ở 3 */
+static void s3_on_hit(cache_shard_t *shard, page_id_t page) {
+    (void)shard;
+
+    unsigned flags = page_flags(page);
+
+    while ((flags & S3_FREQ_MASK) != S3_FREQ_MASK) {
+        if (atomic_compare_exchange_weak_explicit(&g_cache.page_flags[page], &flags,
+                                                  flags + S3_FREQ_ONE,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            break;
+        }
+    }
+}
+
+static void s3_on_insert(cache_shard_t *shard, page_id_t page, bool cold) {
+    s3fifo_state_t *st = s3_state(shard);
+    uint64_t key = page_key_of(page);
+    bool in_ghost = ghost_find(&st->ghosts, key) != NULL;
+
+    if (in_ghost) {
+        ghost_remove(&st->ghosts, key);
+    }
+
+    /*
+     * Page cold không được đưa từ G vào M, và là page tiếp theo rời S trừ
+     * khi là page đọc trước chưa được đọc.
+     */
+    if (cold && !page_test(page, PAGE_PREFETCHED)) {
+        queue_push_front(&st->small, page);
+    } else if (cold) {
+        queue_push_back(&st->small, page);
+    } else if (in_ghost) {
+        page_set(page, S3_IN_MAIN);
+        queue_push_back(&st->main, page);
+    } else {
+        queue_push_back(&st->small, page);
+    }
+}
+
+static page_id_t s3_choose_victim(cache_shard_t *shard) {
+    s3fifo_state_t *st = s3_state(shard);
+
+    /* Mỗi page có thể được chuyển S -> M một lần và giảm tần suất tối đa 3 lần */
+    size_t budget = 4 * (st->small.count + st->main.count) + 1;
+
+    while (st->small.count + st->main.count > 0 && budget-- > 0) {
+        bool from_small = st->small.count > st->small_target || st->main.count == 0;
+        page_queue_t *q = from_small ? &st->small : &st->main;
+        page_id_t page = q->head;
+
+        if (!page_evictable(page)) {
+            queue_move_to_back(q, page);
+            continue;
+        }
+
+        if (from_small) {
+            if (s3_freq(page) > 0) {
+                queue_remove(&st->small, page);
+                page_clear(page, S3_FREQ_MASK);
+                page_set(page, S3_IN_MAIN);
+                queue_push_back(&st->main, page);
+                continue;
+            }
+        } else if (s3_freq(page) > 0) {
+            atomic_fetch_sub_explicit(&g_cache.page_flags[page], S3_FREQ_ONE, memory_order_relaxed);
+            queue_move_to_back(&st->main, page);
+            continue;
+        }
+
+        return page;
+    }
+
+    errno = (st->small.count + st->main.count > 0) ? EBUSY : ENOMEM;
+    return PAGE_NONE;
+}
+
+static void s3_on_remove(cache_shard_t *shard, page_id_t page, bool evicted) {
+    s3fifo_state_t *st = s3_state(shard);
+    bool in_main = page_test(page, S3_IN_MAIN);
+
+    queue_remove(in_main ? &st->main : &st->small, page);
+    page_clear(page, S3_IN_MAIN | S3_FREQ_MASK);
+
+    /* Chỉ page rời S mà chưa được đọc lại mới được nhớ trong G */
+    if (evicted && !in_main) {
+        if (st->ghost.count >= st->ghosts.capacity) {
+            ghost_drop_oldest(&st->ghosts, &st->ghost);
+        }
+        ghost_push(&st->ghosts, &st->ghost, page_key_of(page));
+    }
+}
+
+const cache_policy_t policy_s3fifo = {
+    .name = "S3-FIFO",
+    .lockless_hit = true,
+    .init = s3_init,
+    .destroy = s3_destroy,
+    .on_hit = s3_on_hit,
+    .on_insert = s3_on_insert,
+    .choose_victim = s3_choose_victim,
+    .on_remove = s3_on_remove,
+};
@@ -0,0 +1,248 @@
+/**
+ * radix_tree.c - Cây radix theo block_num, dùng làm index các page của một file
+ *
+ * Mỗi node có 64 slot (6 bit key mỗi tầng) và một bitmap slot đang dùng để
+ * duyệt theo thứ tự offset bằng ctz. Node lá chứa page_id 32 bit thay vì
+ * con trỏ. Chiều cao tăng khi key lớn hơn.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "vtpc_internal.h"
+
+#define RADIX_BITS 6
+#define RADIX_SLOTS (1u << RADIX_BITS)
+#define RADIX_MAX_HEIGHT ((64 + RADIX_BITS - 1) / RADIX_BITS)
+
+typedef struct {
+    uint64_t bitmap;
+    void *child[RADIX_SLOTS];
+} radix_inner_t;
+
+typedef struct {
+    uint64_t bitmap;
+    uint32_t value[RADIX_SLOTS];
+} radix_leaf_t;
+
+/* Cả hai loại node đều bắt đầu bằng bitmap */
+static uint64_t *node_bitmap(void *node) {
+    return (uint64_t *)node;
+}
+
+static uint64_t radix_max_key(unsigned height) {
+    if (height * RADIX_BITS >= 64) {
+        return UINT64_MAX;
+    }
+    return (1ULL << (height * RADIX_BITS)) - 1;
+}
+
+static void *alloc_node(unsigned level) {
+    void *node = calloc(1, level > 0 ? sizeof(radix_inner_t) : sizeof(radix_leaf_t));
+    if (node == NULL) {
+        errno = ENOMEM;
+    }
+    return node;
+}
+
+static void free_node(void *node, unsigned level) {
+    if (level > 0) {
+        radix_inner_t *inner = node;
+        uint64_t bits = inner->bitmap;
+        while (bits != 0) {
+            free_node(inner->child[__builtin_ctzll(bits)], level - 1);
+            bits &= bits - 1;
+        }
+    }
+    free(node);
+}
+
+void radix_init(radix_tree_t *tree) {
+    tree->root = NULL;
+    tree->height = 0;
+    tree->count = 0;
+}
+
+void radix_destroy(radix_tree_t *tree) {
+    if (tree->root != NULL) {
+        free_node(tree->root, tree->height - 1);
+    }
+    radix_init(tree);
+}
+
+int radix_insert(radix_tree_t *tree, uint64_t key, uint32_t value) {
+    if (tree->root == NULL) {
+        unsigned height = 1;
+        while (key > radix_max_key(height)) {
+            height++;
+        }
+
+        tree->root = alloc_node(height - 1);
+        if (tree->root == NULL) {
+            return -1;
+        }
+        tree->height = height;
+    }
+
+    while (key > radix_max_key(tree->height)) {
+        radix_inner_t *node = alloc_node(tree->height);
+        if (node == NULL) {
+            return -1;
+        }
+
+        node->child[0] = tree->root;
+        node->bitmap = 1;
+        tree->root = node;
+        tree->height++;
+    }
+
+    void *node = tree->root;
+
+    for (unsigned level = tree->height - 1; level > 0; level--) {
+        radix_inner_t *inner = node;
+        unsigned idx = (unsigned)(key >> (level * RADIX_BITS)) & (RADIX_SLOTS - 1);
+
+        if (inner->child[idx] == NULL) {
+            void *child = alloc_node(level - 1);
+            if (child == NULL) {
+                return -1;
+            }
+            inner->child[idx] = child;
+            inner->bitmap |= 1ULL << idx;
+        }
+        node = inner->child[idx];
+    }
+
+    radix_leaf_t *leaf = node;
+    unsigned idx = (unsigned)key & (RADIX_SLOTS - 1);
+
+    if ((leaf->bitmap & (1ULL << idx)) == 0) {
+        tree->count++;
+    }
+    leaf->value[idx] = value;
+    leaf->bitmap |= 1ULL << idx;
+
+    return 0;
+}
+
+static radix_leaf_t *find_leaf(const radix_tree_t *tree, uint64_t key) {
+    if (tree->root == NULL || key > radix_max_key(tree->height)) {
+        return NULL;
+    }
+
+    void *node = tree->root;
+
+    for (unsigned level = tree->height - 1; level > 0 && node != NULL; level--) {
+        node = ((radix_inner_t *)node)->child[(key >> (level * RADIX_BITS)) & (RADIX_SLOTS - 1)];
+    }
+
+    return node;
+}
+
+bool radix_lookup(const radix_tree_t *tree, uint64_t key, uint32_t *value) {
+    radix_leaf_t *leaf = find_leaf(tree, key);
+    unsigned idx = (unsigned)key & (RADIX_SLOTS - 1);
+
+    if (leaf == NULL || (leaf->bitmap & (1ULL << idx)) == 0) {
+        return false;
+    }
+
+    *value = leaf->value[idx];
+    return true;
+}
+
+bool radix_delete(radix_tree_t *tree, uint64_t key) {
+    if (tree->root == NULL || key > radix_max_key(tree->height)) {
+        return false;
+    }
+
+    void *path[RADIX_MAX_HEIGHT];
+    unsigned path_idx[RADIX_MAX_HEIGHT];
+    void *node = tree->root;
+
+    for (unsigned level = tree->height - 1; ; level--) {
+        unsigned idx = (unsigned)(key >> (level * RADIX_BITS)) & (RADIX_SLOTS - 1);
+
+        path[level] = node;
+        path_idx[level] = idx;
+
+        if (level == 0) {
+            break;
+        }
+
+        node = ((radix_inner_t *)node)->child[idx];
+        if (node == NULL) {
+            return false;
+        }
+    }
+
+    if ((*node_bitmap(path[0]) & (1ULL << path_idx[0])) == 0) {
+        return false;
+    }
+
+    /* Gỡ value rồi giải phóng các node rỗng từ dưới lên */
+    for (unsigned level = 0; level < tree->height; level++) {
+        node = path[level];
+        if (level > 0) {
+            ((radix_inner_t *)node)->child[path_idx[level]] = NULL;
+        }
+        *node_bitmap(node) &= ~(1ULL << path_idx[level]);
+
+        if (*node_bitmap(node) != 0) {
+            break;
+        }
+
+        free(node);
+        if (level == tree->height - 1) {
+            tree->root = NULL;
+            tree->height = 0;
+        }
+    }
+
+    tree->count--;
+
+    return true;
+}
+
+static size_t gather_node(const void *node, unsigned level, uint64_t base,
+                          uint64_t start, uint32_t *values, uint64_t *keys,
+                          size_t n, size_t max) {
+    unsigned shift = level * RADIX_BITS;
+    uint64_t bits = *(const uint64_t *)node;
+
+    if (start > base) {
+        uint64_t first = (start - base) >> shift;
+        if (first >= RADIX_SLOTS) {
+            return n;
+        }
+        bits &= ~0ULL << first;
+    }
+
+    while (bits != 0 && n < max) {
+        unsigned idx = (unsigned)__builtin_ctzll(bits);
+        uint64_t child_base = base + ((uint64_t)idx << shift);
+
+        bits &= bits - 1;
+
+        if (level == 0) {
+            values[n] = ((const radix_leaf_t *)node)->value[idx];
+            keys[n] = child_base;
+            n++;
+        } else {
+            n = gather_node(((const radix_inner_t *)node)->child[idx], level - 1,
+                            child_base, start, values, keys, n, max);
+        }
+    }
+
+    return n;
+}
+
+/* Lấy tối đa max value có key >= start, theo thứ tự key tăng dần */
+size_t radix_gather(const radix_tree_t *tree, uint64_t start,
+                    uint32_t *values, uint64_t *keys, size_t max) {
+    if (tree->root == NULL || start > radix_max_key(tree->height)) {
+        return 0;
+    }
+
+    return gather_node(tree->root, tree->height - 1, 0, start, values, keys, 0, max);
+}
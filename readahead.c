@@ -0,0 +1,234 @@
+/**
+ * readahead.c - Đọc trước bất đồng bộ theo từng file
+ *
+ * vtpc_read() báo từng block được đọc qua readahead_note(). Khi file đang
+ * được đọc tuần tự, một cửa sổ block phía trước được gửi cho các worker
+ * nạp vào cache. Mỗi khi người đọc tới đầu cửa sổ vừa gửi, cửa sổ kế tiếp
+ * (gấp đôi, tối đa readahead_pages) được gửi; nếu page đọc trước của file
+ * bị evict khi chưa được đọc thì cửa sổ giảm một nửa.
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include "vtpc_internal.h"
+
+static void *readahead_worker(void *arg) {
+    readahead_t *ra = &g_cache.readahead;
+
+    (void)arg;
+
+    pthread_mutex_lock(&ra->lock);
+
+    for (;;) {
+        while (ra->count == 0 && !ra->stop) {
+            pthread_cond_wait(&ra->cond, &ra->lock);
+        }
+        if (ra->stop) {
+            break;
+        }
+
+        readahead_req_t req = ra->queue[ra->head];
+        ra->head = (ra->head + 1) % VTPC_RA_QUEUE;
+        ra->count--;
+
+        /* Đếm dưới lock để readahead_cancel() chờ được yêu cầu này */
+        file_entry_t *file = get_file_entry(req.fd);
+        file->ra_inflight++;
+
+        pthread_mutex_unlock(&ra->lock);
+
+        off_t end = req.first_block + (off_t)req.nblocks;
+
+        for (off_t block = req.first_block; block < end; block += VTPC_CLUSTER_MAX) {
+            if (atomic_load(&file->ra_gen) != req.gen) {
+                break;
+            }
+            /* Yêu cầu đến muộn: page đã được đọc, có thể đã bị evict */
+            off_t pos = atomic_load(&file->ra_pos);
+            if (block < pos) {
+                block = pos;
+                if (block >= end) {
+                    break;
+                }
+            }
+
+            size_t n = (end - block < VTPC_CLUSTER_MAX) ? (size_t)(end - block) : VTPC_CLUSTER_MAX;
+
+            /* Page đọc trước là suy đoán nên luôn vào ở đầu bị evict */
+            if (cache_prefetch_pages(req.fd, block, n, ACCESS_STREAM) < 0) {
+                break;
+            }
+        }
+
+        pthread_mutex_lock(&ra->lock);
+        file->ra_inflight--;
+        pthread_cond_broadcast(&ra->idle);
+    }
+
+    pthread_mutex_unlock(&ra->lock);
+
+    return NULL;
+}
+
+int readahead_start(size_t threads) {
+    readahead_t *ra = &g_cache.readahead;
+
+    ra->head = 0;
+    ra->count = 0;
+    ra->stop = false;
+    ra->nthreads = 0;
+
+    if (pthread_mutex_init(&ra->lock, NULL) != 0) {
+        return -1;
+    }
+    pthread_cond_init(&ra->cond, NULL);
+    pthread_cond_init(&ra->idle, NULL);
+    ra->running = true;
+
+    for (size_t i = 0; i < threads && i < VTPC_RA_THREADS; i++) {
+        if (pthread_create(&ra->threads[i], NULL, readahead_worker, NULL) != 0) {
+            readahead_stop();
+            errno = EAGAIN;
+            return -1;
+        }
+        ra->nthreads++;
+    }
+
+    return 0;
+}
+
+/* Yêu cầu còn trong hàng đợi bị bỏ */
+void readahead_stop(void) {
+    readahead_t *ra = &g_cache.readahead;
+
+    if (!ra->running) {
+        return;
+    }
+
+    pthread_mutex_lock(&ra->lock);
+    ra->stop = true;
+    pthread_cond_broadcast(&ra->cond);
+    pthread_mutex_unlock(&ra->lock);
+
+    for (size_t i = 0; i < ra->nthreads; i++) {
+        pthread_join(ra->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&ra->idle);
+    pthread_cond_destroy(&ra->cond);
+    pthread_mutex_destroy(&ra->lock);
+
+    ra->nthreads = 0;
+    ra->running = false;
+}
+
+/*
+ * Gọi trước khi đóng file: yêu cầu cũ bị bỏ và hàm chỉ trả về khi không
+ * worker nào còn nạp page cho file, nên real_fd và fd có thể dùng lại.
+ */
+void readahead_cancel(file_entry_t *file) {
+    readahead_t *ra = &g_cache.readahead;
+
+    atomic_fetch_add(&file->ra_gen, 1);
+
+    if (!ra->running) {
+        return;
+    }
+
+    pthread_mutex_lock(&ra->lock);
+    while (file->ra_inflight > 0) {
+        pthread_cond_wait(&ra->idle, &ra->lock);
+    }
+    pthread_mutex_unlock(&ra->lock);
+}
+
+/* Đọc trước chỉ là gợi ý: hàng đợi đầy thì yêu cầu bị bỏ */
+static void readahead_submit(int fd, file_entry_t *file, off_t first_block, size_t nblocks) {
+    readahead_t *ra = &g_cache.readahead;
+
+    pthread_mutex_lock(&ra->lock);
+
+    if (ra->count < VTPC_RA_QUEUE) {
+        readahead_req_t *req = &ra->queue[(ra->head + ra->count) % VTPC_RA_QUEUE];
+
+        req->fd = fd;
+        req->gen = atomic_load(&file->ra_gen);
+        req->first_block = first_block;
+        req->nblocks = nblocks;
+        ra->count++;
+
+        pthread_cond_signal(&ra->cond);
+    }
+
+    pthread_mutex_unlock(&ra->lock);
+}
+
+/*
+ * Gọi dưới file->lock cho mỗi block vtpc_read() đọc, sau file_note_read().
+ * Chuỗi tuần tự bị đứt thì dừng đọc trước và bỏ các yêu cầu còn chờ.
+ */
+void readahead_note(file_entry_t *file, int fd, off_t block_num, unsigned hint) {
+    size_t page_size = g_cache.page_size;
+
+    if (!g_cache.readahead.running || (hint & ACCESS_REREAD)) {
+        return;
+    }
+
+    atomic_store(&file->ra_pos, block_num + 1);
+
+    if (file->seq_run < VTPC_RA_MIN_RUN) {
+        if (file->ra_size != 0) {
+            atomic_fetch_add(&file->ra_gen, 1);
+            file->ra_size = 0;
+        }
+        return;
+    }
+
+    if (file->ra_size == 0) {
+        file->ra_size = (g_cache.readahead_pages < VTPC_RA_MIN_PAGES) ?
+                        g_cache.readahead_pages : VTPC_RA_MIN_PAGES;
+        file->ra_next = block_num + 1;
+        file->ra_trigger = block_num;
+        file->ra_wasted_seen = atomic_load(&file->ra_wasted);
+    }
+
+    if (block_num < file->ra_trigger) {
+        return;
+    }
+
+    size_t wasted = atomic_load(&file->ra_wasted);
+    if (wasted != file->ra_wasted_seen) {
+        file->ra_wasted_seen = wasted;
+        if (file->ra_size / 2 >= VTPC_RA_MIN_PAGES) {
+            file->ra_size /= 2;
+        }
+    }
+
+    /* Người đọc đã vượt qua cửa sổ */
+    if (file->ra_next <= block_num) {
+        file->ra_next = block_num + 1;
+    }
+
+    off_t end_block = (file->file_size + (off_t)page_size - 1) / (off_t)page_size;
+    size_t n = file->ra_size;
+
+    if (file->ra_next >= end_block) {
+        file->ra_trigger = file->ra_next;
+        return;
+    }
+    if ((off_t)n > end_block - file->ra_next) {
+        n = (size_t)(end_block - file->ra_next);
+    }
+
+    readahead_submit(fd, file, file->ra_next, n);
+
+    file->ra_trigger = file->ra_next;
+    file->ra_next += (off_t)n;
+
+    if (file->ra_size * 2 <= g_cache.readahead_pages) {
+        file->ra_size *= 2;
+    } else {
+        file->ra_size = g_cache.readahead_pages;
+    }
+}
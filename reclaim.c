@@ -0,0 +1,118 @@
+/**
+ * reclaim.c - Luồng thu hồi page trống
+ *
+ * Giữ free list của mỗi shard trên free_low bằng cách evict victim theo lô
+ * ở nền, để miss trên cache đầy thường chỉ phải lấy một page trống thay vì
+ * tự quét policy. Luồng chạy mỗi VTPC_RECLAIM_INTERVAL_MS hoặc ngay khi
+ * một miss thấy free list rỗng.
+ */
+
+#include <time.h>
+#include <errno.h>
+
+#include "vtpc_internal.h"
+
+static void reclaim_pass(void) {
+    for (size_t i = 0; i < g_cache.num_shards; i++) {
+        cache_reclaim_shard(&g_cache.shards[i]);
+    }
+}
+
+static void *reclaim_thread(void *arg) {
+    reclaim_t *rc = &g_cache.reclaim;
+
+    (void)arg;
+
+    pthread_mutex_lock(&rc->lock);
+
+    for (;;) {
+        if (!rc->stop && !atomic_load(&rc->pending)) {
+            struct timespec deadline;
+
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_nsec += VTPC_RECLAIM_INTERVAL_MS * 1000000L;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+
+            pthread_cond_timedwait(&rc->cond, &rc->lock, &deadline);
+        }
+        if (rc->stop) {
+            break;
+        }
+        atomic_store(&rc->pending, false);
+
+        pthread_mutex_unlock(&rc->lock);
+        reclaim_pass();
+        pthread_mutex_lock(&rc->lock);
+    }
+
+    pthread_mutex_unlock(&rc->lock);
+
+    return NULL;
+}
+
+int reclaim_start(void) {
+    reclaim_t *rc = &g_cache.reclaim;
+    pthread_condattr_t attr;
+
+    atomic_store(&rc->pending, false);
+    rc->stop = false;
+
+    if (pthread_mutex_init(&rc->lock, NULL) != 0) {
+        return -1;
+    }
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&rc->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&rc->thread, NULL, reclaim_thread, NULL) != 0) {
+        pthread_cond_destroy(&rc->cond);
+        pthread_mutex_destroy(&rc->lock);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    rc->running = true;
+
+    return 0;
+}
+
+void reclaim_stop(void) {
+    reclaim_t *rc = &g_cache.reclaim;
+
+    if (!rc->running) {
+        return;
+    }
+
+    pthread_mutex_lock(&rc->lock);
+    rc->stop = true;
+    pthread_cond_signal(&rc->cond);
+    pthread_mutex_unlock(&rc->lock);
+
+    pthread_join(rc->thread, NULL);
+
+    pthread_cond_destroy(&rc->cond);
+    pthread_mutex_destroy(&rc->lock);
+
+    rc->running = false;
+}
+
+/*
+ * Gọi dưới shard->lock từ đường miss. Chỉ lần gọi đầu tiên kể từ lượt thu
+ * hồi trước mới lấy lock của luồng; lỡ một lần đánh thức thì luồng vẫn tự
+ * dậy sau một chu kỳ.
+ */
+void reclaim_kick(void) {
+    reclaim_t *rc = &g_cache.reclaim;
+
+    if (!rc->running || atomic_exchange(&rc->pending, true)) {
+        return;
+    }
+
+    pthread_mutex_lock(&rc->lock);
+    pthread_cond_signal(&rc->cond);
+    pthread_mutex_unlock(&rc->lock);
+}
@@ -0,0 +1,337 @@
+/**
+ * storage_mem.c - Thiết bị giả lập trong RAM
+ *
+ * Lần mở đầu tiên một path chép nội dung file thật (nếu có) vào RAM; mọi
+ * đọc/ghi sau đó chỉ chạm bản sao này, file thật không bao giờ bị ghi.
+ * Bản sao sống tới vtpc_destroy(), nên đóng rồi mở lại vẫn thấy dữ liệu đã
+ * ghi. Mỗi I/O chờ latency_us, còn phần truyền dữ liệu của các I/O được
+ * xếp nối tiếp theo bandwidth_mb, để đo policy độc lập với đĩa của máy.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "vtpc_internal.h"
+
+typedef struct {
+    char *path;
+    char *data;
+    size_t size;
+    size_t capacity;
+    pthread_rwlock_t lock;      /* ghi giữ exclusive vì có thể realloc data */
+} mem_file_t;
+
+static struct {
+    pthread_mutex_t lock;       /* bảo vệ files[] và busy_until */
+    mem_file_t *files[VTPC_MAX_OPEN_FILES];
+    uint64_t latency_ns;
+    uint64_t bytes_per_sec;
+    uint64_t busy_until;        /* thời điểm kênh truyền rảnh */
+} mem = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* Chờ như thiết bị thật: xếp hàng trên kênh truyền rồi thêm độ trễ cố định */
+static void mem_delay(size_t bytes) {
+    if (mem.latency_ns == 0 && mem.bytes_per_sec == 0) {
+        return;
+    }
+
+    uint64_t done = now_ns();
+
+    if (mem.bytes_per_sec > 0) {
+        pthread_mutex_lock(&mem.lock);
+        if (mem.busy_until > done) {
+            done = mem.busy_until;
+        }
+        done += (uint64_t)bytes * 1000000000ull / mem.bytes_per_sec;
+        mem.busy_until = done;
+        pthread_mutex_unlock(&mem.lock);
+    }
+    done += mem.latency_ns;
+
+    struct timespec ts = {
+        .tv_sec = (time_t)(done / 1000000000ull),
+        .tv_nsec = (long)(done % 1000000000ull),
+    };
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+}
+
+static mem_file_t *mem_file(int handle) {
+    mem_file_t *file = NULL;
+
+    if (handle >= 0 && handle < VTPC_MAX_OPEN_FILES) {
+        pthread_mutex_lock(&mem.lock);
+        file = mem.files[handle];
+        pthread_mutex_unlock(&mem.lock);
+    }
+    if (file == NULL) {
+        errno = EBADF;
+    }
+
+    return file;
+}
+
+static void mem_file_free(mem_file_t *file) {
+    pthread_rwlock_destroy(&file->lock);
+    free(file->data);
+    free(file->path);
+    free(file);
+}
+
+/* Nội dung ban đầu là file thật; không có file thì bắt đầu rỗng */
+static mem_file_t *mem_file_load(const char *path) {
+    mem_file_t *file = calloc(1, sizeof(*file));
+    if (file == NULL) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    pthread_rwlock_init(&file->lock, NULL);
+    file->path = strdup(path);
+    if (file->path == NULL) {
+        mem_file_free(file);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return file;
+        }
+        int saved = errno;
+        mem_file_free(file);
+        errno = saved;
+        return NULL;
+    }
+
+    struct stat st;
+    int result = fstat(fd, &st);
+
+    if (result == 0 && st.st_size > 0) {
+        file->data = malloc((size_t)st.st_size);
+        if (file->data == NULL) {
+            errno = ENOMEM;
+            result = -1;
+        }
+        file->capacity = (size_t)st.st_size;
+    }
+
+    while (result == 0 && file->size < file->capacity) {
+        ssize_t n = pread(fd, file->data + file->size, file->capacity - file->size,
+                          (off_t)file->size);
+        if (n < 0 && errno != EINTR) {
+            result = -1;
+        } else if (n == 0) {
+            break;
+        } else if (n > 0) {
+            file->size += (size_t)n;
+        }
+    }
+
+    int saved = errno;
+    close(fd);
+
+    if (result < 0) {
+        mem_file_free(file);
+        errno = saved;
+        return NULL;
+    }
+
+    return file;
+}
+
+static int mem_start(unsigned latency_us, unsigned bandwidth_mb) {
+    mem.latency_ns = (uint64_t)latency_us * 1000;
+    mem.bytes_per_sec = (uint64_t)bandwidth_mb << 20;
+    mem.busy_until = 0;
+
+    return 0;
+}
+
+static void mem_stop(void) {
+    pthread_mutex_lock(&mem.lock);
+
+    for (int i = 0; i < VTPC_MAX_OPEN_FILES; i++) {
+        if (mem.files[i] != NULL) {
+            mem_file_free(mem.files[i]);
+            mem.files[i] = NULL;
+        }
+    }
+
+    pthread_mutex_unlock(&mem.lock);
+}
+
+/* Mọi lần mở cùng một path dùng chung handle và bản sao */
+static int mem_open(const char *path, bool direct, bool *opened_direct) {
+    int handle = -1;
+    int free_slot = -1;
+
+    (void)direct;
+    *opened_direct = false;
+
+    pthread_mutex_lock(&mem.lock);
+
+    for (int i = 0; i < VTPC_MAX_OPEN_FILES && handle < 0; i++) {
+        if (mem.files[i] == NULL) {
+            if (free_slot < 0) {
+                free_slot = i;
+            }
+        } else if (strcmp(mem.files[i]->path, path) == 0) {
+            handle = i;
+        }
+    }
+
+    if (handle < 0) {
+        if (free_slot < 0) {
+            errno = EMFILE;
+        } else {
+            mem.files[free_slot] = mem_file_load(path);
+            if (mem.files[free_slot] != NULL) {
+                handle = free_slot;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&mem.lock);
+
+    return handle;
+}
+
+static int mem_close(int handle) {
+    return (mem_file(handle) != NULL) ? 0 : -1;
+}
+
+static ssize_t mem_readv(int handle, const struct iovec *iov, int iovcnt, off_t offset) {
+    mem_file_t *file = mem_file(handle);
+    if (file == NULL) {
+        return -1;
+    }
+    if (offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t pos = (size_t)offset;
+    size_t done = 0;
+
+    pthread_rwlock_rdlock(&file->lock);
+
+    for (int i = 0; i < iovcnt && pos < file->size; i++) {
+        size_t n = iov[i].iov_len;
+
+        if (n > file->size - pos) {
+            n = file->size - pos;
+        }
+        memcpy(iov[i].iov_base, file->data + pos, n);
+        pos += n;
+        done += n;
+    }
+
+    pthread_rwlock_unlock(&file->lock);
+
+    mem_delay(done);
+
+    return (ssize_t)done;
+}
+
+static ssize_t mem_writev(int handle, const struct iovec *iov, int iovcnt, off_t offset) {
+    mem_file_t *file = mem_file(handle);
+    if (file == NULL) {
+        return -1;
+    }
+    if (offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t pos = (size_t)offset;
+    size_t total = 0;
+
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+    }
+
+    pthread_rwlock_wrlock(&file->lock);
+
+    if (pos + total > file->capacity) {
+        size_t capacity = (file->capacity * 2 > pos + total) ? file->capacity * 2 : pos + total;
+        char *data = realloc(file->data, capacity);
+
+        if (data == NULL) {
+            pthread_rwlock_unlock(&file->lock);
+            errno = ENOMEM;
+            return -1;
+        }
+        file->data = data;
+        file->capacity = capacity;
+    }
+    if (pos > file->size) {
+        memset(file->data + file->size, 0, pos - file->size);
+    }
+
+    for (int i = 0; i < iovcnt; i++) {
+        memcpy(file->data + pos, iov[i].iov_base, iov[i].iov_len);
+        pos += iov[i].iov_len;
+    }
+    if (pos > file->size) {
+        file->size = pos;
+    }
+
+    pthread_rwlock_unlock(&file->lock);
+
+    mem_delay(total);
+
+    return (ssize_t)total;
+}
+
+static off_t mem_size(int handle) {
+    mem_file_t *file = mem_file(handle);
+    if (file == NULL) {
+        return -1;
+    }
+
+    pthread_rwlock_rdlock(&file->lock);
+    off_t size = (off_t)file->size;
+    pthread_rwlock_unlock(&file->lock);
+
+    return size;
+}
+
+/* Cache ghi của thiết bị được coi như đã xả: chỉ tốn một lần độ trễ */
+static int mem_sync(int handle) {
+    if (mem_file(handle) == NULL) {
+        return -1;
+    }
+
+    mem_delay(0);
+
+    return 0;
+}
+
+const storage_backend_t storage_memory = {
+    .name = "memory",
+    .kernel_fd = false,
+    .start = mem_start,
+    .stop = mem_stop,
+    .open = mem_open,
+    .close = mem_close,
+    .readv = mem_readv,
+    .writev = mem_writev,
+    .size = mem_size,
+    .sync = mem_sync,
+};
@@ -1,14 +1,20 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
 #include <sys/stat.h>
+#include <pthread.h>
 
 #include "vtpc.h"
 
 #define TEST_FILE "test_data.tmp"
 #define TEST_FILE2 "test_data2.tmp"
+#define NUM_THREADS 4
 
 #define RED     "\033[31m"
 #define GREEN   "\033[32m"
@@ -336,6 +342,132 @@ static void test_cache_hits(void) {
     TEST_PASS();
 }
 
+static void test_metadata_overhead(void) {
+    TEST_START("Compact per-page metadata");
+
+    vtpc_destroy();
+    vtpc_init(4096, 4096);
+
+    vtpc_stats_t stats;
+    if (vtpc_get_stats(&stats) < 0) {
+        TEST_FAIL("vtpc_get_stats failed");
+        vtpc_destroy();
+        return;
+    }
+
+    /* Mô tả page + slot hash phải nhỏ hơn một cache line mỗi page */
+    if (stats.metadata_bytes == 0 || stats.metadata_bytes_per_page >= 64) {
+        TEST_FAIL("Per-page metadata too large");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_destroy();
+    TEST_PASS();
+}
+
+static void test_arena_config(void) {
+    TEST_START("Contiguous page arena via vtpc_init_ex");
+
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 8;
+    config.huge_pages = 0;
+
+    if (vtpc_init_ex(&config) < 0) {
+        TEST_FAIL("vtpc_init_ex failed");
+        return;
+    }
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+    if (stats.arena_backing != VTPC_BACKING_4K || stats.arena_bytes < 8 * 4096) {
+        TEST_FAIL("Wrong arena without huge pages");
+        vtpc_destroy();
+        return;
+    }
+
+    create_test_file(TEST_FILE, 16 * 4096);
+    int fd = vtpc_open(TEST_FILE);
+    char buf[4096];
+    for (int i = 0; i < 16; i++) {
+        if (vtpc_read(fd, buf, sizeof(buf)) != sizeof(buf) || buf[i + 1] != (char)(i + 1)) {
+            TEST_FAIL("Wrong data from arena page");
+            vtpc_close(fd);
+            vtpc_destroy();
+            return;
+        }
+    }
+    vtpc_close(fd);
+    vtpc_destroy();
+
+    /* Huge page: arena làm tròn lên bội số 2 MB */
+    config.huge_pages = 1;
+    vtpc_init_ex(&config);
+    vtpc_get_stats(&stats);
+    if (stats.arena_backing != VTPC_BACKING_4K && stats.arena_bytes % (2 << 20) != 0) {
+        TEST_FAIL("Huge page arena not rounded to 2 MB");
+        vtpc_destroy();
+        return;
+    }
+    vtpc_destroy();
+
+    /* mlock có thể bị RLIMIT_MEMLOCK từ chối, nhưng không được để lại trạng thái dở */
+    config.huge_pages = 0;
+    config.lock_memory = 1;
+    if (vtpc_init_ex(&config) == 0) {
+        vtpc_destroy();
+    }
+    if (vtpc_init(8, 4096) < 0) {
+        TEST_FAIL("vtpc_init failed after mlock attempt");
+        return;
+    }
+
+    vtpc_destroy();
+    cleanup_test_files();
+    TEST_PASS();
+}
+
+static void test_lazy_materialization(void) {
+    TEST_START("Lazy page materialization on large cache");
+
+    vtpc_destroy();
+    if (vtpc_init(1 << 20, 4096) < 0) {
+        TEST_FAIL("vtpc_init (4 GB cache) failed");
+        return;
+    }
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+    if (stats.pages_materialized != 0) {
+        TEST_FAIL("Pages materialized before first use");
+        vtpc_destroy();
+        return;
+    }
+
+    create_test_file(TEST_FILE, 3 * 4096);
+    int fd = vtpc_open(TEST_FILE);
+    char buf[4096];
+    for (int i = 0; i < 3; i++) {
+        vtpc_read(fd, buf, sizeof(buf));
+    }
+
+    vtpc_get_stats(&stats);
+    if (stats.pages_materialized != 3 || stats.current_pages_used != 3) {
+        TEST_FAIL("Expected exactly 3 materialized pages");
+        vtpc_close(fd);
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_close(fd);
+    vtpc_destroy();
+    cleanup_test_files();
+    TEST_PASS();
+}
+
 static void test_second_chance(void) {
     TEST_START("Second Chance eviction policy");
 
@@ -384,6 +516,78 @@ static void test_second_chance(void) {
     TEST_PASS();
 }
 
+/*
+ * Kim CLOCK bỏ qua page có reference bit (và xóa bit đó) rồi lấy page kế
+ * tiếp chưa được tham chiếu. Block đọc theo bước 2 để không bị coi là đọc
+ * tuần tự; page thứ i của shard giữ block 2i.
+ */
+static void test_clock_reference_bit(void) {
+    TEST_START("Second Chance skips a referenced page once");
+
+    vtpc_destroy();
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 8;
+    config.policy = VTPC_POLICY_SECOND_CHANCE;
+    config.readahead_pages = 0;
+    config.reclaim_low_ratio = 0;
+    vtpc_init_ex(&config);
+
+    create_test_file(TEST_FILE, 20 * 4096);
+    int fd = vtpc_open(TEST_FILE);
+    char buf[4096];
+
+    for (int i = 0; i < 8; i++) {
+        vtpc_lseek(fd, (off_t)i * 2 * 4096, SEEK_SET);
+        vtpc_read(fd, buf, sizeof(buf));
+    }
+
+    /* Mọi page vừa nạp đều có bit: vòng đầu xóa hết, kim dừng ở block 0 */
+    vtpc_lseek(fd, 16 * 4096, SEEK_SET);
+    vtpc_read(fd, buf, sizeof(buf));
+
+    /* Block 2 ngay dưới kim được tham chiếu lại, block 4 sau nó thì không */
+    vtpc_lseek(fd, 2 * 4096, SEEK_SET);
+    vtpc_read(fd, buf, sizeof(buf));
+    vtpc_lseek(fd, 18 * 4096, SEEK_SET);
+    vtpc_read(fd, buf, sizeof(buf));
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+    if (stats.pages_evicted != 2) {
+        TEST_FAIL("Expected exactly two evictions");
+        vtpc_close(fd);
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_reset_stats();
+    vtpc_lseek(fd, 2 * 4096, SEEK_SET);
+    vtpc_read(fd, buf, sizeof(buf));
+    vtpc_get_stats(&stats);
+    if (stats.cache_hits != 1) {
+        TEST_FAIL("Referenced page did not survive the sweep");
+        vtpc_close(fd);
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_lseek(fd, 4 * 4096, SEEK_SET);
+    vtpc_read(fd, buf, sizeof(buf));
+    vtpc_get_stats(&stats);
+    if (stats.cache_misses != 1) {
+        TEST_FAIL("Unreferenced page after the hand was not chosen");
+        vtpc_close(fd);
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_close(fd);
+    vtpc_destroy();
+    cleanup_test_files();
+    TEST_PASS();
+}
+
 static void test_fsync(void) {
     TEST_START("vtpc_fsync");
 
@@ -518,6 +722,1706 @@ static void test_large_file(void) {
     TEST_PASS();
 }
 
+/*
+ * Đọc/ghi lớn với buffer căn theo page đi thẳng xuống thiết bị nhưng vẫn
+ * thấy page dirty. Trả về NULL nếu đúng, ngược lại là mô tả lỗi.
+ */
+static const char *check_direct_bypass(unsigned char *big, size_t pages) {
+    vtpc_stats_t stats;
+    int fd = vtpc_open(TEST_FILE);
+
+    for (size_t i = 0; i < pages * 4096; i++) {
+        big[i] = (unsigned char)(i / 4096);
+    }
+
+    if (vtpc_write(fd, big, pages * 4096) != (ssize_t)(pages * 4096) ||
+        vtpc_get_stats(&stats) != 0 || stats.pages_bypassed != pages ||
+        stats.current_pages_used != 0) {
+        vtpc_close(fd);
+        return "Large aligned write went through the cache";
+    }
+
+    /* Page 100 dirty trong cache, mới hơn dữ liệu trên đĩa */
+    unsigned char small[4096];
+    memset(small, 0xEE, sizeof(small));
+    vtpc_lseek(fd, 100 * 4096, SEEK_SET);
+    vtpc_write(fd, small, sizeof(small));
+
+    vtpc_reset_stats();
+    memset(big, 0, pages * 4096);
+    vtpc_lseek(fd, 0, SEEK_SET);
+    ssize_t n = vtpc_read(fd, big, pages * 4096);
+    vtpc_get_stats(&stats);
+    vtpc_close(fd);
+
+    if (n != (ssize_t)(pages * 4096)) {
+        return "Large aligned read failed";
+    }
+    for (size_t i = 0; i < pages * 4096; i++) {
+        unsigned char expected = (i / 4096 == 100) ? 0xEE : (unsigned char)(i / 4096);
+        if (big[i] != expected) {
+            return "Bypassed read is not coherent with dirty pages";
+        }
+    }
+    if (stats.pages_bypassed < 128 || stats.cache_hits == 0) {
+        return "Read did not bypass uncached pages";
+    }
+
+    /* bypass_pages = 0 tắt đường đi thẳng */
+    vtpc_destroy();
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 64;
+    config.bypass_pages = 0;
+    vtpc_init_ex(&config);
+
+    fd = vtpc_open(TEST_FILE);
+    vtpc_read(fd, big, pages * 4096);
+    vtpc_get_stats(&stats);
+    vtpc_close(fd);
+
+    if (stats.pages_bypassed != 0 || big[100 * 4096] != 0xEE) {
+        return "bypass_pages = 0 did not disable the bypass";
+    }
+
+    return NULL;
+}
+
+/*
+ * Đọc tuần tự 128 page, nghỉ một chút sau mỗi page như người đọc đang xử lý
+ * dữ liệu. Trả về -1 nếu dữ liệu sai.
+ */
+static int sequential_read_stats(size_t readahead_pages, vtpc_stats_t *stats) {
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 512;
+    config.readahead_pages = readahead_pages;
+
+    if (vtpc_init_ex(&config) < 0) {
+        return -1;
+    }
+
+    create_test_file(TEST_FILE, 128 * 4096);
+    int fd = vtpc_open(TEST_FILE);
+    unsigned char buf[4096];
+
+    for (int i = 0; i < 128; i++) {
+        if (vtpc_read(fd, buf, sizeof(buf)) != sizeof(buf)) {
+            vtpc_close(fd);
+            return -1;
+        }
+        for (size_t j = 0; j < sizeof(buf); j++) {
+            if (buf[j] != (unsigned char)j) {
+                vtpc_close(fd);
+                return -1;
+            }
+        }
+        usleep(200);
+    }
+
+    vtpc_get_stats(stats);
+    vtpc_close(fd);
+
+    return 0;
+}
+
+static void test_readahead(void) {
+    TEST_START("Sequential reads are prefetched");
+
+    vtpc_stats_t stats;
+
+    if (sequential_read_stats(64, &stats) < 0) {
+        TEST_FAIL("Read failed or returned wrong data");
+        vtpc_destroy();
+        return;
+    }
+    if (stats.pages_prefetched == 0 || stats.prefetch_hits == 0 ||
+        stats.cache_misses >= 128) {
+        TEST_FAIL("Sequential reads were not prefetched");
+        vtpc_destroy();
+        return;
+    }
+
+    /*
+     * Một lần đọc 4 page nạp chung cả cụm; cửa sổ đọc trước phải bắt đầu sau
+     * block cuối của cụm, không dừng ở block đầu chưa đủ dài để là chuỗi.
+     */
+    vtpc_destroy();
+    vtpc_init(512, 4096);
+    int cfd = vtpc_open(TEST_FILE);
+    char cluster[4 * 4096];
+
+    if (vtpc_read(cfd, cluster, sizeof(cluster)) != sizeof(cluster)) {
+        TEST_FAIL("Clustered read failed");
+        vtpc_close(cfd);
+        vtpc_destroy();
+        return;
+    }
+    for (int i = 0; i < 1000; i++) {
+        vtpc_get_stats(&stats);
+        if (stats.pages_prefetched > 0) {
+            break;
+        }
+        usleep(1000);
+    }
+    vtpc_close(cfd);
+    if (stats.pages_prefetched == 0) {
+        TEST_FAIL("Clustered read did not start readahead");
+        vtpc_destroy();
+        return;
+    }
+
+    if (sequential_read_stats(0, &stats) < 0 || stats.pages_prefetched != 0) {
+        TEST_FAIL("readahead_pages = 0 did not disable readahead");
+        vtpc_destroy();
+        return;
+    }
+
+    /* Đóng file khi worker còn đang đọc trước, rồi dùng lại fd */
+    vtpc_destroy();
+    vtpc_init(512, 4096);
+    char small[64];
+
+    for (int round = 0; round < 20; round++) {
+        int fd = vtpc_open(TEST_FILE);
+        for (int i = 0; i < 8; i++) {
+            vtpc_lseek(fd, (off_t)i * 4096, SEEK_SET);
+            vtpc_read(fd, small, sizeof(small));
+        }
+        vtpc_close(fd);
+    }
+
+    int fd = vtpc_open(TEST_FILE);
+    vtpc_lseek(fd, 100 * 4096 + 5, SEEK_SET);
+    if (vtpc_read(fd, small, 1) != 1 || small[0] != 5) {
+        TEST_FAIL("Data mismatch after closing during readahead");
+        vtpc_close(fd);
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_close(fd);
+    vtpc_destroy();
+    cleanup_test_files();
+    TEST_PASS();
+}
+
+static void test_clustered_miss(void) {
+    TEST_START("Contiguous misses are read with one call");
+
+    vtpc_destroy();
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 256;
+    /* Đếm lời gọi đọc nên không để đọc trước chen vào */
+    config.readahead_pages = 0;
+    vtpc_init_ex(&config);
+
+    create_test_file(TEST_FILE, 64 * 4096);
+    int fd = vtpc_open(TEST_FILE);
+
+    /* Block 10 đã có: hai dải miss 0-9 và 11-20 */
+    unsigned char buf[21 * 4096];
+    vtpc_lseek(fd, 10 * 4096, SEEK_SET);
+    vtpc_read(fd, buf, 16);
+
+    vtpc_reset_stats();
+    vtpc_lseek(fd, 100, SEEK_SET);
+    ssize_t n = vtpc_read(fd, buf, 20 * 4096);
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    if (n != 20 * 4096) {
+        TEST_FAIL("Multi-page read failed");
+        vtpc_close(fd);
+        vtpc_destroy();
+        return;
+    }
+    for (size_t i = 0; i < (size_t)n; i++) {
+        if (buf[i] != (unsigned char)(i + 100)) {
+            TEST_FAIL("Data mismatch in clustered read");
+            vtpc_close(fd);
+            vtpc_destroy();
+            return;
+        }
+    }
+    if (stats.device_reads != 2 || stats.cache_misses != 20 || stats.cache_hits != 1) {
+        TEST_FAIL("Contiguous misses were not read together");
+        vtpc_close(fd);
+        vtpc_destroy();
+        return;
+    }
+
+    /* Dải dài hơn VTPC_CLUSTER_MAX được chia thành nhiều lời gọi */
+    vtpc_reset_stats();
+    vtpc_lseek(fd, 21 * 4096 + 1, SEEK_SET);
+    unsigned char *big = malloc(43 * 4096);
+    n = vtpc_read(fd, big, 43 * 4096);
+    vtpc_get_stats(&stats);
+    free(big);
+
+    vtpc_close(fd);
+    vtpc_destroy();
+    cleanup_test_files();
+
+    if (n != 43 * 4096 - 1 || stats.device_reads != 2 || stats.cache_misses != 43) {
+        TEST_FAIL("Long miss run was not split into clusters");
+        return;
+    }
+    TEST_PASS();
+}
+
+static void test_direct_bypass(void) {
+    TEST_START("Large aligned I/O bypasses the cache");
+
+    vtpc_destroy();
+    vtpc_init(64, 4096);
+    unlink(TEST_FILE);
+
+    unsigned char *big = NULL;
+    if (posix_memalign((void **)&big, 4096, 256 * 4096) != 0) {
+        TEST_FAIL("posix_memalign failed");
+        vtpc_destroy();
+        return;
+    }
+
+    const char *error = check_direct_bypass(big, 256);
+
+    free(big);
+    vtpc_destroy();
+    cleanup_test_files();
+
+    if (error != NULL) {
+        TEST_FAIL(error);
+        return;
+    }
+    TEST_PASS();
+}
+
+static void test_lookaside_invalidation(void) {
+    TEST_START("Lookaside invalidated on evict and close");
+
+    vtpc_destroy();
+    vtpc_init(4, 4096);
+
+    FILE *f = fopen(TEST_FILE, "wb");
+    for (int p = 0; p < 8; p++) {
+        for (int i = 0; i < 4096; i++) {
+            fputc(p, f);
+        }
+    }
+    fclose(f);
+
+    int fd = vtpc_open(TEST_FILE);
+    char buf[16];
+
+    for (int i = 0; i < 10; i++) {
+        vtpc_lseek(fd, i, SEEK_SET);
+        vtpc_read(fd, buf, sizeof(buf));
+    }
+
+    for (int p = 1; p < 8; p++) {
+        vtpc_lseek(fd, (off_t)p * 4096, SEEK_SET);
+        vtpc_read(fd, buf, sizeof(buf));
+    }
+
+    vtpc_lseek(fd, 0, SEEK_SET);
+    vtpc_read(fd, buf, sizeof(buf));
+    if (buf[0] != 0) {
+        TEST_FAIL("Stale page served after eviction");
+        vtpc_close(fd);
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_close(fd);
+
+    create_test_file(TEST_FILE2, 4096);
+    int fd2 = vtpc_open(TEST_FILE2);
+    vtpc_lseek(fd2, 5, SEEK_SET);
+    vtpc_read(fd2, buf, sizeof(buf));
+
+    if (fd2 != fd || buf[0] != 5) {
+        TEST_FAIL("Stale page served after close");
+        vtpc_close(fd2);
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_close(fd2);
+    vtpc_destroy();
+    cleanup_test_files();
+    TEST_PASS();
+}
+
+/* Ghi pages page rồi chờ luồng ghi ngầm; trả về stats sau khi chờ */
+static void write_and_wait(int fd, int pages, unsigned wait_ms, vtpc_stats_t *stats) {
+    char buf[4096];
+
+    for (int i = 0; i < pages; i++) {
+        memset(buf, 'A' + i % 26, sizeof(buf));
+        vtpc_write(fd, buf, sizeof(buf));
+    }
+
+    usleep(wait_ms * 1000);
+    vtpc_get_stats(stats);
+}
+
+static void test_background_writeback(void) {
+    TEST_START("Background writeback by age and dirty ratio");
+
+    vtpc_destroy();
+    unlink(TEST_FILE);
+
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 256;
+    config.writeback_interval_ms = 10;
+    config.dirty_expire_ms = 50;
+    config.dirty_background_ratio = 50;
+    config.dirty_ratio = 100;
+    vtpc_init_ex(&config);
+
+    /* Dưới ngưỡng: chỉ được ghi khi hết hạn, không cần fsync */
+    vtpc_stats_t stats;
+    int fd = vtpc_open(TEST_FILE);
+    write_and_wait(fd, 8, 0, &stats);
+    size_t dirty_now = stats.dirty_pages;
+    usleep(300 * 1000);
+    vtpc_get_stats(&stats);
+
+    char disk[4096];
+    int raw = open(TEST_FILE, O_RDONLY);
+    ssize_t n = pread(raw, disk, sizeof(disk), 7 * 4096);
+    close(raw);
+
+    if (dirty_now != 8 || stats.dirty_pages != 0 || stats.pages_flushed_background != 8 ||
+        n != sizeof(disk) || disk[0] != 'H') {
+        TEST_FAIL("Expired dirty pages were not written in the background");
+        vtpc_close(fd);
+        vtpc_destroy();
+        return;
+    }
+    vtpc_close(fd);
+
+    /* Vượt dirty_background_ratio: ghi cả page chưa hết hạn */
+    vtpc_destroy();
+    config.dirty_expire_ms = 60000;
+    config.dirty_background_ratio = 5;
+    config.dirty_ratio = 10;
+    vtpc_init_ex(&config);
+
+    fd = vtpc_open(TEST_FILE);
+    write_and_wait(fd, 100, 300, &stats);
+    vtpc_close(fd);
+
+    if (stats.dirty_background_pages != 12 || stats.dirty_limit_pages != 25 ||
+        stats.dirty_pages > 12 || stats.pages_flushed_background < 88) {
+        TEST_FAIL("Dirty pages above the background ratio were not written");
+        vtpc_destroy();
+        return;
+    }
+    if (stats.writers_throttled == 0) {
+        TEST_FAIL("Writer was not throttled at the dirty limit");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_destroy();
+    cleanup_test_files();
+    TEST_PASS();
+}
+
+/* Đọc ngẫu nhiên 2000 page trên file gấp 4 lần cache; trả về stats sau khi nghỉ */
+static void random_reads_stats(unsigned reclaim_low_ratio, vtpc_stats_t *stats) {
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 256;
+    config.readahead_pages = 0;
+    config.reclaim_low_ratio = reclaim_low_ratio;
+    vtpc_init_ex(&config);
+
+    char buf[4096];
+    int fd = vtpc_open(TEST_FILE);
+    srand(7);
+    for (int i = 0; i < 2000; i++) {
+        vtpc_lseek(fd, (off_t)(rand() % 1024) * 4096, SEEK_SET);
+        vtpc_read(fd, buf, sizeof(buf));
+    }
+    usleep(50 * 1000);
+    vtpc_get_stats(stats);
+    vtpc_close(fd);
+
+    vtpc_destroy();
+}
+
+static void test_background_reclaim(void) {
+    TEST_START("Background reclaim keeps free pages");
+
+    vtpc_destroy();
+    create_test_file(TEST_FILE, 1024 * 4096);
+
+    vtpc_stats_t off, on;
+    random_reads_stats(0, &off);
+    random_reads_stats(10, &on);
+
+    if (off.pages_reclaimed != 0 || off.free_pages != 0 || off.direct_evictions != off.pages_evicted) {
+        TEST_FAIL("Reclaim ran while disabled");
+        return;
+    }
+    /* Sau khi nghỉ luồng thu hồi đã nạp lại free list */
+    if (on.pages_reclaimed == 0 || on.free_pages == 0 ||
+        on.direct_evictions >= off.direct_evictions) {
+        TEST_FAIL("Misses still evicted inline with reclaim enabled");
+        return;
+    }
+
+    cleanup_test_files();
+    TEST_PASS();
+}
+
+static void test_fsync_per_file(void) {
+    TEST_START("fsync flushes only its own file");
+
+    /* Không có luồng ghi ngầm để số page được ghi chỉ đến từ fsync/close */
+    vtpc_destroy();
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 64;
+    config.writeback_interval_ms = 0;
+    vtpc_init_ex(&config);
+
+    unlink(TEST_FILE);
+    unlink(TEST_FILE2);
+
+    int fd1 = vtpc_open(TEST_FILE);
+    int fd2 = vtpc_open(TEST_FILE2);
+
+    char buf[4096];
+    for (int i = 0; i < 8; i++) {
+        memset(buf, 'a' + i, sizeof(buf));
+        vtpc_write(fd1, buf, sizeof(buf));
+        vtpc_write(fd2, buf, sizeof(buf));
+    }
+
+    vtpc_fsync(fd1);
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    if (stats.pages_written_back != 8) {
+        TEST_FAIL("fsync wrote back pages of another file");
+        vtpc_close(fd1);
+        vtpc_close(fd2);
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_close(fd2);
+    vtpc_get_stats(&stats);
+
+    if (stats.pages_written_back != 16 || stats.current_pages_used != 8) {
+        TEST_FAIL("close did not flush and drop the file's pages");
+        vtpc_close(fd1);
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_close(fd1);
+    vtpc_destroy();
+    cleanup_test_files();
+    TEST_PASS();
+}
+
+typedef struct {
+    const char *path;
+    int errors;
+} thread_arg_t;
+
+static void test_coalesced_flush(void) {
+    TEST_START("fsync coalesces adjacent dirty pages");
+
+    vtpc_destroy();
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 256;
+    config.writeback_interval_ms = 0;
+    vtpc_init_ex(&config);
+
+    unlink(TEST_FILE);
+    int fd = vtpc_open(TEST_FILE);
+
+    /* Block 0..39 và 50..51: lô 32 + 8 page, rồi lô 2 page */
+    char buf[4096];
+    for (int i = 0; i < 52; i++) {
+        if (i == 40) {
+            vtpc_lseek(fd, 50 * 4096, SEEK_SET);
+            i = 50;
+        }
+        memset(buf, 'a' + i % 26, sizeof(buf));
+        vtpc_write(fd, buf, sizeof(buf));
+    }
+
+    vtpc_reset_stats();
+    vtpc_fsync(fd);
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    char disk[4096];
+    int raw = open(TEST_FILE, O_RDONLY);
+    ssize_t n1 = pread(raw, disk, sizeof(disk), 35 * 4096);
+    char c1 = disk[4095];
+    ssize_t n2 = pread(raw, disk, sizeof(disk), 51 * 4096);
+    close(raw);
+
+    if (stats.pages_written_back != 42 || stats.device_writes != 3 || stats.dirty_pages != 0) {
+        TEST_FAIL("Dirty runs were not written with one call each");
+        vtpc_close(fd);
+        vtpc_destroy();
+        return;
+    }
+    if (n1 != sizeof(disk) || c1 != 'a' + 35 % 26 || n2 != sizeof(disk) || disk[0] != 'a' + 51 % 26) {
+        TEST_FAIL("Coalesced write put data at the wrong offset");
+        vtpc_close(fd);
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_close(fd);
+    vtpc_destroy();
+    cleanup_test_files();
+    TEST_PASS();
+}
+
+static void test_sector_writeback(void) {
+    TEST_START("Writeback writes only dirty sectors");
+
+    vtpc_destroy();
+    create_test_file(TEST_FILE, 4 * 65536);
+
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 64;
+    config.page_size = 65536;
+    config.writeback_interval_ms = 0;
+    config.readahead_pages = 0;
+    vtpc_init_ex(&config);
+    /* Thiết bị sector 4K sẽ buộc O_DIRECT ghi cả page */
+    vtpc_set_direct_mode(0);
+
+    /* Sector 1 của page 0, rồi sector cuối page 0 + sector đầu page 1 (một dải) */
+    int fd = vtpc_open(TEST_FILE);
+    vtpc_lseek(fd, 1000, SEEK_SET);
+    vtpc_write(fd, "ABCD", 4);
+    vtpc_lseek(fd, 65532, SEEK_SET);
+    vtpc_write(fd, "EFGHIJKL", 8);
+
+    vtpc_reset_stats();
+    vtpc_fsync(fd);
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    unsigned char disk[66048];
+    int raw = open(TEST_FILE, O_RDONLY);
+    ssize_t n = pread(raw, disk, sizeof(disk), 0);
+    close(raw);
+
+    int intact = (n == (ssize_t)sizeof(disk));
+    for (size_t i = 0; intact && i < sizeof(disk); i++) {
+        if ((i < 1000 || i >= 1004) && (i < 65532 || i >= 65540) && disk[i] != i % 256) {
+            intact = 0;
+        }
+    }
+
+    if (stats.device_writes != 2 || stats.pages_written_back != 2 ||
+        stats.write_bytes_saved != 2 * 65536 - 3 * 512 || stats.dirty_pages != 0) {
+        TEST_FAIL("Clean sectors were written back");
+        vtpc_close(fd);
+        vtpc_destroy();
+        return;
+    }
+    if (!intact || memcmp(disk + 1000, "ABCD", 4) != 0 || memcmp(disk + 65532, "EFGHIJKL", 8) != 0) {
+        TEST_FAIL("Sector writeback corrupted the file");
+        vtpc_close(fd);
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_close(fd);
+    vtpc_destroy();
+    cleanup_test_files();
+    TEST_PASS();
+}
+
+/* Ghi 32 page cách nhau một page rồi fsync; trả về 0 nếu đĩa đúng dữ liệu */
+static int scattered_fsync(int io_backend, vtpc_stats_t *stats) {
+    vtpc_destroy();
+    unlink(TEST_FILE);
+
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 256;
+    config.writeback_interval_ms = 0;
+    config.io_backend = io_backend;
+    if (vtpc_init_ex(&config) < 0) {
+        return -1;
+    }
+
+    char buf[4096];
+    int fd = vtpc_open(TEST_FILE);
+    for (int i = 0; i < 32; i++) {
+        memset(buf, 'a' + i % 26, sizeof(buf));
+        vtpc_lseek(fd, (off_t)i * 2 * 4096, SEEK_SET);
+        vtpc_write(fd, buf, sizeof(buf));
+    }
+
+    vtpc_reset_stats();
+    vtpc_fsync(fd);
+    vtpc_get_stats(stats);
+    vtpc_close(fd);
+    vtpc_destroy();
+
+    int raw = open(TEST_FILE, O_RDONLY);
+    int bad = 0;
+    for (int i = 0; i < 32 && !bad; i++) {
+        if (pread(raw, buf, sizeof(buf), (off_t)i * 2 * 4096) != sizeof(buf) ||
+            buf[0] != 'a' + i % 26 || buf[4095] != 'a' + i % 26) {
+            bad = 1;
+        }
+    }
+    close(raw);
+
+    return bad ? -1 : 0;
+}
+
+static void test_io_backend(void) {
+    TEST_START("Batched I/O through io_uring or sync fallback");
+
+    vtpc_destroy();
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.io_backend = 7;
+    if (vtpc_init_ex(&config) == 0 || errno != EINVAL) {
+        TEST_FAIL("Invalid io_backend was accepted");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_stats_t sync_stats, auto_stats;
+    if (scattered_fsync(VTPC_IO_SYNC, &sync_stats) < 0 || scattered_fsync(VTPC_IO_AUTO, &auto_stats) < 0) {
+        TEST_FAIL("Scattered writeback lost data");
+        return;
+    }
+
+    if (sync_stats.io_backend != VTPC_IO_SYNC || sync_stats.uring_submits != 0 ||
+        sync_stats.device_writes != 32 || auto_stats.device_writes != 32) {
+        TEST_FAIL("Sync backend did not write each page with its own call");
+        return;
+    }
+    /* Kernel không cho io_uring thì AUTO là SYNC */
+    if (auto_stats.io_backend == VTPC_IO_URING && auto_stats.uring_submits != 1) {
+        TEST_FAIL("io_uring did not submit the batch at once");
+        return;
+    }
+
+    cleanup_test_files();
+    TEST_PASS();
+}
+
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double)(now.tv_sec - start->tv_sec) * 1e3 + (double)(now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void test_memory_storage(void) {
+    TEST_START("In-memory storage with emulated latency");
+
+    vtpc_destroy();
+    create_test_file(TEST_FILE, 8 * 4096);
+
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.storage = VTPC_STORAGE_MEMORY;
+    config.io_backend = VTPC_IO_URING;
+    if (vtpc_init_ex(&config) == 0 || errno != EINVAL) {
+        TEST_FAIL("io_uring was accepted for in-memory storage");
+        vtpc_destroy();
+        return;
+    }
+
+    config.io_backend = VTPC_IO_AUTO;
+    config.storage_latency_us = 2000;
+    config.readahead_pages = 0;
+    if (vtpc_init_ex(&config) < 0) {
+        TEST_FAIL("vtpc_init_ex failed");
+        return;
+    }
+
+    int fd = vtpc_open(TEST_FILE);
+    char buf[4096];
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    vtpc_lseek(fd, 4096 + 100, SEEK_SET);
+    ssize_t n = vtpc_read(fd, buf, 64);
+    double miss_ms = elapsed_ms(&start);
+
+    int ok = (n == 64);
+    for (int i = 0; ok && i < 64; i++) {
+        ok = buf[i] == (char)((4096 + 100 + i) % 256);
+    }
+    if (!ok) {
+        TEST_FAIL("Read did not see the host file contents");
+        vtpc_destroy();
+        return;
+    }
+    if (miss_ms < 2.0) {
+        TEST_FAIL("Miss did not pay the emulated latency");
+        vtpc_destroy();
+        return;
+    }
+
+    memset(buf, 'M', sizeof(buf));
+    vtpc_lseek(fd, 0, SEEK_SET);
+    if (vtpc_write(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf) || vtpc_fsync(fd) < 0 ||
+        vtpc_close(fd) < 0) {
+        TEST_FAIL("Write to in-memory storage failed");
+        vtpc_destroy();
+        return;
+    }
+
+    /* Đóng rồi mở lại: page cũ đã bị bỏ, dữ liệu phải đến từ bản sao trong RAM */
+    fd = vtpc_open(TEST_FILE);
+    memset(buf, 0, sizeof(buf));
+    if (vtpc_read(fd, buf, 16) != 16 || memcmp(buf, "MMMMMMMMMMMMMMMM", 16) != 0) {
+        TEST_FAIL("Written data was lost by the in-memory device");
+        vtpc_destroy();
+        return;
+    }
+    vtpc_destroy();
+
+    int raw = open(TEST_FILE, O_RDONLY);
+    n = read(raw, buf, 16);
+    close(raw);
+    if (n != 16 || buf[0] != 0 || buf[15] != 15) {
+        TEST_FAIL("In-memory device wrote to the host file");
+        return;
+    }
+
+    cleanup_test_files();
+    TEST_PASS();
+}
+
+static void async_done(vtpc_aio_t *aio) {
+    __atomic_add_fetch((int *)aio->user_data, 1, __ATOMIC_RELEASE);
+}
+
+static void test_async_io(void) {
+    TEST_START("Async reads and writes complete off the caller");
+
+    vtpc_destroy();
+    create_test_file(TEST_FILE, 64 * 4096);
+
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 256;
+    config.readahead_pages = 0;
+    config.storage = VTPC_STORAGE_MEMORY;
+    config.storage_latency_us = 2000;
+    if (vtpc_init_ex(&config) < 0) {
+        TEST_FAIL("vtpc_init_ex failed");
+        return;
+    }
+
+    int fd = vtpc_open(TEST_FILE);
+    int efd = vtpc_aio_fd();
+    vtpc_aio_t reqs[16];
+    char bufs[16][100];
+    struct timespec start;
+
+    /* 16 miss rời nhau: nối tiếp sẽ mất 16 lần độ trễ */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < 16; i++) {
+        memset(&reqs[i], 0, sizeof(reqs[i]));
+        reqs[i].fd = fd;
+        reqs[i].buf = bufs[i];
+        reqs[i].count = sizeof(bufs[i]);
+        reqs[i].offset = (off_t)i * 3 * 4096 + 10;
+        if (vtpc_read_async(&reqs[i]) != 1) {
+            TEST_FAIL("Miss was not queued");
+            vtpc_destroy();
+            return;
+        }
+    }
+
+    size_t reaped = 0;
+    while (reaped < 16) {
+        struct pollfd pfd = { .fd = efd, .events = POLLIN };
+        uint64_t events;
+        vtpc_aio_t *done[16];
+
+        if (poll(&pfd, 1, 1000) != 1 || read(efd, &events, sizeof(events)) != sizeof(events)) {
+            TEST_FAIL("eventfd did not signal completion");
+            vtpc_destroy();
+            return;
+        }
+        reaped += vtpc_aio_reap(done, 16 - reaped);
+    }
+    double elapsed = elapsed_ms(&start);
+
+    for (int i = 0; i < 16; i++) {
+        if (reqs[i].result != 100 || bufs[i][0] != (char)((reqs[i].offset) % 256) ||
+            bufs[i][99] != (char)((reqs[i].offset + 99) % 256)) {
+            TEST_FAIL("Async read returned wrong data");
+            vtpc_destroy();
+            return;
+        }
+    }
+    if (elapsed >= 16 * 2.0) {
+        TEST_FAIL("Outstanding misses were serviced one at a time");
+        vtpc_destroy();
+        return;
+    }
+
+    /* Hit xong ngay, không qua worker */
+    vtpc_aio_t hit = { .fd = fd, .buf = bufs[0], .count = 50, .offset = 20 };
+    char data[4096];
+    memset(data, 'A', sizeof(data));
+    vtpc_aio_t overwrite = { .fd = fd, .buf = data, .count = 64, .offset = 3 * 4096 };
+    if (vtpc_read_async(&hit) != 0 || hit.result != 50 || bufs[0][0] != 20 ||
+        vtpc_write_async(&overwrite) != 0 || overwrite.result != 64) {
+        TEST_FAIL("Hit did not complete immediately");
+        vtpc_destroy();
+        return;
+    }
+
+    int completed = 0;
+    vtpc_aio_t miss = { .fd = fd, .buf = data, .count = 4096, .offset = 40 * 4096,
+                        .callback = async_done, .user_data = &completed };
+    if (vtpc_write_async(&miss) != 1) {
+        TEST_FAIL("Write miss was not queued");
+        vtpc_destroy();
+        return;
+    }
+    for (int i = 0; i < 1000 && __atomic_load_n(&completed, __ATOMIC_ACQUIRE) == 0; i++) {
+        usleep(1000);
+    }
+
+    char check[4];
+    vtpc_lseek(fd, 40 * 4096, SEEK_SET);
+    if (completed != 1 || miss.result != 4096 || vtpc_read(fd, check, 4) != 4 ||
+        memcmp(check, "AAAA", 4) != 0) {
+        TEST_FAIL("Write callback missing or data not written");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+    if (stats.aio_queued != 17 || stats.aio_completed_inline != 2) {
+        TEST_FAIL("Async stats do not match");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_close(fd);
+    vtpc_destroy();
+    cleanup_test_files();
+    TEST_PASS();
+}
+
+static void test_pin_unpin(void) {
+    TEST_START("Pinned pages survive eviction until unpin");
+
+    vtpc_destroy();
+    create_test_file(TEST_FILE, 256 * 4096);
+
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 64;
+    config.readahead_pages = 0;
+    if (vtpc_init_ex(&config) < 0) {
+        TEST_FAIL("vtpc_init_ex failed");
+        return;
+    }
+    vtpc_set_direct_mode(0);
+
+    int fd = vtpc_open(TEST_FILE);
+    char *ptr;
+    size_t len;
+    int handle = vtpc_pin(fd, 4096 + 10, (void **)&ptr, &len);
+    if (handle < 0 || len != 4096 - 10 || ptr[0] != (char)10 || ptr[len - 1] != (char)255) {
+        TEST_FAIL("Pin did not expose the cached page");
+        vtpc_destroy();
+        return;
+    }
+
+    /* Đọc cả file qua cache 64 page: mọi page khác đều bị evict */
+    char buf[4096];
+    while (vtpc_read(fd, buf, sizeof(buf)) > 0) {
+    }
+
+    vtpc_stats_t before, after;
+    vtpc_get_stats(&before);
+    vtpc_lseek(fd, 4096, SEEK_SET);
+    vtpc_read(fd, buf, 16);
+    vtpc_get_stats(&after);
+
+    if (after.cache_misses != before.cache_misses || before.pins_active != 1 || ptr[0] != (char)10) {
+        TEST_FAIL("Pinned page was evicted");
+        vtpc_destroy();
+        return;
+    }
+    if (vtpc_close(fd) == 0 || errno != EBUSY) {
+        TEST_FAIL("File with a pinned page was closed");
+        vtpc_destroy();
+        return;
+    }
+
+    ptr[0] = 'Z';
+    if (vtpc_unpin(handle, 1) < 0 || vtpc_unpin(handle, 0) == 0 || errno != EINVAL) {
+        TEST_FAIL("Unpin did not release the handle exactly once");
+        vtpc_destroy();
+        return;
+    }
+
+    /* 64 page / 4 = 16 pin cùng lúc */
+    int handles[17];
+    int pinned = 0;
+    while (pinned < 17 && (handles[pinned] = vtpc_pin(fd, (off_t)pinned * 4096, (void **)&ptr, &len)) >= 0) {
+        pinned++;
+    }
+    int full_errno = errno;
+    for (int i = 0; i < pinned; i++) {
+        vtpc_unpin(handles[i], 0);
+    }
+    if (pinned != 16 || full_errno != ENOBUFS) {
+        TEST_FAIL("Pin limit not enforced");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_get_stats(&after);
+    if (after.pins_active != 0 || after.pins_total != 17) {
+        TEST_FAIL("Pin stats do not match");
+        vtpc_destroy();
+        return;
+    }
+
+    if (vtpc_close(fd) < 0) {
+        TEST_FAIL("Close after unpin failed");
+        vtpc_destroy();
+        return;
+    }
+    vtpc_destroy();
+
+    int raw = open(TEST_FILE, O_RDONLY);
+    ssize_t n = pread(raw, buf, 2, 4096 + 10);
+    close(raw);
+    if (n != 2 || buf[0] != 'Z' || buf[1] != (char)11) {
+        TEST_FAIL("Dirty unpin was not written back");
+        return;
+    }
+
+    /*
+     * 256 page chia 4 shard, mỗi shard giữ tối đa 16 pin: shard đầu tiên
+     * đầy làm pin thất bại trước khi đủ 64, và miss vào shard đó vẫn còn
+     * victim.
+     */
+    config.cache_size_pages = 256;
+    config.reclaim_low_ratio = 0;
+    if (vtpc_init_ex(&config) < 0) {
+        TEST_FAIL("vtpc_init_ex failed");
+        return;
+    }
+    vtpc_set_direct_mode(0);
+
+    fd = vtpc_open(TEST_FILE);
+    int many[64];
+    int first_full = -1;
+    pinned = 0;
+    for (int i = 0; i < 256 && pinned < 64; i++) {
+        int h = vtpc_pin(fd, (off_t)i * 4096, (void **)&ptr, &len);
+        if (h >= 0) {
+            many[pinned++] = h;
+        } else if (errno != ENOBUFS) {
+            break;
+        } else if (first_full < 0) {
+            first_full = pinned;
+        }
+    }
+
+    int reads_ok = 1;
+    for (int i = 0; i < 256 && reads_ok; i++) {
+        vtpc_lseek(fd, (off_t)i * 4096, SEEK_SET);
+        reads_ok = vtpc_read(fd, buf, 2) == 2 && buf[1] == (char)1;
+    }
+
+    for (int i = 0; i < pinned; i++) {
+        vtpc_unpin(many[i], 0);
+    }
+    vtpc_close(fd);
+    vtpc_destroy();
+
+    if (first_full < 0 || first_full >= 64 || pinned > 64) {
+        TEST_FAIL("Pin limit not enforced per shard");
+        return;
+    }
+    if (!reads_ok) {
+        TEST_FAIL("Read failed with a shard full of pins");
+        return;
+    }
+
+    cleanup_test_files();
+    TEST_PASS();
+}
+
+static void *concurrent_reader(void *arg) {
+    thread_arg_t *t = (thread_arg_t *)arg;
+
+    int fd = vtpc_open(t->path);
+    if (fd < 0) {
+        t->errors++;
+        return NULL;
+    }
+
+    char buf[512];
+    unsigned int seed = (unsigned int)fd;
+
+    for (int i = 0; i < 2000; i++) {
+        off_t offset = (off_t)(rand_r(&seed) % (256 * 4096 - sizeof(buf)));
+
+        vtpc_lseek(fd, offset, SEEK_SET);
+        if (vtpc_read(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+            t->errors++;
+            continue;
+        }
+
+        for (int j = 0; j < (int)sizeof(buf); j++) {
+            if (buf[j] != (char)((offset + j) % 256)) {
+                t->errors++;
+                break;
+            }
+        }
+    }
+
+    vtpc_close(fd);
+    return NULL;
+}
+
+/* Mỗi thread đọc ngẫu nhiên một file 256 page riêng; trả về số lỗi dữ liệu */
+static int run_concurrent_readers(void) {
+    char paths[NUM_THREADS][32];
+    pthread_t threads[NUM_THREADS];
+    thread_arg_t args[NUM_THREADS];
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "test_mt_%d.tmp", i);
+        create_test_file(paths[i], 256 * 4096);
+        args[i].path = paths[i];
+        args[i].errors = 0;
+    }
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_create(&threads[i], NULL, concurrent_reader, &args[i]);
+    }
+
+    int errors = 0;
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        errors += args[i].errors;
+        unlink(paths[i]);
+    }
+
+    return errors;
+}
+
+static void test_concurrent_readers(void) {
+    TEST_START("Concurrent readers on sharded cache");
+
+    vtpc_destroy();
+    vtpc_init(512, 4096);
+
+    int errors = run_concurrent_readers();
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    if (errors != 0) {
+        TEST_FAIL("Data mismatch under concurrent reads");
+        vtpc_destroy();
+        return;
+    }
+
+    if (stats.cache_hits + stats.cache_misses == 0) {
+        TEST_FAIL("No cache activity recorded");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_destroy();
+    TEST_PASS();
+}
+
+typedef struct {
+    const char *path;
+    int writer;
+    int errors;
+} race_arg_t;
+
+/*
+ * Mỗi page của file luôn chứa một byte lặp lại: writer ghi đè cả page của
+ * cùng các block bằng byte mới, reader đọc cả page. Mỗi thread có fd riêng
+ * vì đọc và ghi trên một fd nối tiếp nhau qua file->lock. Page của reader
+ * bị evict và dùng lại trong lúc đang được chép không lock; page đọc được
+ * phải là bản cũ hoặc bản mới, không lẫn hai bản.
+ */
+static void *race_worker(void *arg) {
+    race_arg_t *t = (race_arg_t *)arg;
+    unsigned char buf[4096];
+    unsigned seed = (unsigned)(t->writer * 7919 + 1);
+
+    int fd = vtpc_open(t->path);
+    if (fd < 0) {
+        t->errors++;
+        return NULL;
+    }
+
+    for (int i = 0; i < 40000 && t->errors == 0; i++) {
+        seed = seed * 1103515245u + 12345u;
+        off_t block = (off_t)((seed >> 16) % (t->writer ? 32 : 16));
+
+        vtpc_lseek(fd, block * 4096, SEEK_SET);
+        if (t->writer) {
+            memset(buf, 33 + i % 200, sizeof(buf));
+            if (vtpc_write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+                t->errors++;
+            }
+            continue;
+        }
+
+        if (vtpc_read(fd, buf, sizeof(buf)) != sizeof(buf)) {
+            t->errors++;
+            continue;
+        }
+        for (size_t j = 1; j < sizeof(buf); j++) {
+            if (buf[j] != buf[0]) {
+                t->errors++;
+                break;
+            }
+        }
+    }
+
+    vtpc_close(fd);
+    return NULL;
+}
+
+static void test_optimistic_read_race(void) {
+    TEST_START("Lockless reads racing writes and evictions");
+
+    vtpc_destroy();
+    create_test_file(TEST_FILE, 32 * 4096);
+    int raw = open(TEST_FILE, O_WRONLY);
+    char page[4096];
+    for (int i = 0; i < 32; i++) {
+        memset(page, 1 + i, sizeof(page));
+        pwrite(raw, page, sizeof(page), (off_t)i * 4096);
+    }
+    close(raw);
+
+    /* Thiết bị trong RAM: mỗi I/O nguyên tử, page lẫn chỉ có thể đến từ cache */
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 32;
+    config.policy = VTPC_POLICY_SECOND_CHANCE;
+    config.readahead_pages = 0;
+    config.bypass_pages = 0;
+    config.storage = VTPC_STORAGE_MEMORY;
+    if (vtpc_init_ex(&config) < 0) {
+        TEST_FAIL("vtpc_init_ex failed");
+        return;
+    }
+
+    pthread_t threads[NUM_THREADS + 2];
+    race_arg_t args[NUM_THREADS + 2];
+
+    for (int i = 0; i < NUM_THREADS + 2; i++) {
+        args[i].path = TEST_FILE;
+        args[i].writer = i >= NUM_THREADS;
+        args[i].errors = 0;
+        pthread_create(&threads[i], NULL, race_worker, &args[i]);
+    }
+
+    int errors = 0;
+    for (int i = 0; i < NUM_THREADS + 2; i++) {
+        pthread_join(threads[i], NULL);
+        errors += args[i].errors;
+    }
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+    vtpc_destroy();
+    cleanup_test_files();
+
+    if (errors != 0) {
+        TEST_FAIL("A read returned a torn page");
+        return;
+    }
+    if (stats.cache_hits == 0 || stats.pages_evicted == 0) {
+        TEST_FAIL("Reads did not race evictions");
+        return;
+    }
+
+    TEST_PASS();
+}
+
+/*
+ * Đọc page 0-3 hai lần, quét một lần 20 page khác rồi đọc lại page 0-3.
+ * Trả về số hit của lần đọc cuối, -1 nếu lỗi.
+ */
+static int hot_hits_after_scan(int policy, size_t cache_pages) {
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = cache_pages;
+    config.policy = policy;
+
+    if (vtpc_init_ex(&config) < 0) {
+        return -1;
+    }
+
+    create_test_file(TEST_FILE, 32 * 4096);
+    int fd = vtpc_open(TEST_FILE);
+    char buf[4096];
+
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 4; i++) {
+            vtpc_lseek(fd, (off_t)i * 4096, SEEK_SET);
+            vtpc_read(fd, buf, sizeof(buf));
+        }
+    }
+
+    for (int i = 8; i < 28; i++) {
+        vtpc_lseek(fd, (off_t)i * 4096, SEEK_SET);
+        vtpc_read(fd, buf, sizeof(buf));
+    }
+
+    vtpc_reset_stats();
+    for (int i = 0; i < 4; i++) {
+        vtpc_lseek(fd, (off_t)i * 4096, SEEK_SET);
+        if (vtpc_read(fd, buf, sizeof(buf)) != sizeof(buf) || buf[1] != 1) {
+            vtpc_close(fd);
+            return -1;
+        }
+    }
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    vtpc_close(fd);
+    cleanup_test_files();
+
+    return (int)stats.cache_hits;
+}
+
+static void test_arc_policy(void) {
+    TEST_START("ARC keeps frequently used pages across a scan");
+
+    /* Page dùng hai lần nằm ở T2, lần quét chỉ thay thế trong T1 */
+    if (hot_hits_after_scan(VTPC_POLICY_ARC, 8) != 4) {
+        TEST_FAIL("Hot pages were evicted by the scan");
+        vtpc_destroy();
+        return;
+    }
+
+    /* Cache nhỏ để ghost list và việc dịch p hoạt động dưới tải song song */
+    vtpc_destroy();
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 32;
+    config.policy = VTPC_POLICY_ARC;
+    vtpc_init_ex(&config);
+
+    if (run_concurrent_readers() != 0) {
+        TEST_FAIL("Data mismatch under concurrent reads with ARC");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_destroy();
+    TEST_PASS();
+}
+
+static void test_s3fifo_policy(void) {
+    TEST_START("S3-FIFO drops one-hit pages before the hot set");
+
+    /* Page đọc lại khi còn ở S được chuyển sang M; page quét rời S ngay */
+    if (hot_hits_after_scan(VTPC_POLICY_S3FIFO, 16) != 4) {
+        TEST_FAIL("Hot pages were evicted by the scan");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_destroy();
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 32;
+    config.policy = VTPC_POLICY_S3FIFO;
+    vtpc_init_ex(&config);
+
+    if (run_concurrent_readers() != 0) {
+        TEST_FAIL("Data mismatch under concurrent reads with S3-FIFO");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_destroy();
+    TEST_PASS();
+}
+
+/*
+ * 32 page nóng đọc 4 lần, rồi 200 page lạnh đọc một lần theo bước nhảy 3
+ * (không tuần tự, để phát hiện quét không che mất bộ lọc); trả về số hit
+ * khi đọc lại tập nóng.
+ */
+static int hot_hits_after_cold_reads(int admission) {
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 64;
+    config.admission = admission;
+    /* Tập nóng đọc tuần tự; page đọc trước sau nó làm kết quả phụ thuộc thời điểm */
+    config.readahead_pages = 0;
+
+    if (vtpc_init_ex(&config) < 0) {
+        return -1;
+    }
+
+    create_test_file(TEST_FILE, 264 * 4096);
+    int fd = vtpc_open(TEST_FILE);
+    char buf[4096];
+
+    for (int round = 0; round < 4; round++) {
+        for (int i = 0; i < 32; i++) {
+            vtpc_lseek(fd, (off_t)i * 4096, SEEK_SET);
+            vtpc_read(fd, buf, sizeof(buf));
+        }
+    }
+
+    for (int i = 0; i < 200; i++) {
+        vtpc_lseek(fd, (off_t)(64 + i * 3 % 200) * 4096, SEEK_SET);
+        vtpc_read(fd, buf, sizeof(buf));
+    }
+
+    vtpc_reset_stats();
+    for (int i = 0; i < 32; i++) {
+        vtpc_lseek(fd, (off_t)i * 4096, SEEK_SET);
+        if (vtpc_read(fd, buf, sizeof(buf)) != sizeof(buf) || buf[7] != 7) {
+            vtpc_close(fd);
+            return -1;
+        }
+    }
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    vtpc_close(fd);
+    cleanup_test_files();
+
+    return (int)stats.cache_hits;
+}
+
+static void test_admission_filter(void) {
+    TEST_START("W-TinyLFU admission keeps hot pages");
+
+    int plain = hot_hits_after_cold_reads(0);
+    int filtered = hot_hits_after_cold_reads(1);
+
+    if (plain < 0 || filtered < 0) {
+        TEST_FAIL("Read failed");
+        vtpc_destroy();
+        return;
+    }
+
+    if (filtered < 24 || filtered <= plain) {
+        TEST_FAIL("Cold reads displaced the hot set despite admission");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+    if (stats.admission_sketch_bytes == 0 || stats.admissions_rejected == 0) {
+        TEST_FAIL("Admission stats not reported");
+        vtpc_destroy();
+        return;
+    }
+
+    /* Cửa sổ và cuộc đấu victim dưới tải song song */
+    vtpc_destroy();
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 32;
+    config.admission = 1;
+    vtpc_init_ex(&config);
+
+    if (run_concurrent_readers() != 0) {
+        TEST_FAIL("Data mismatch under concurrent reads with admission");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_destroy();
+    TEST_PASS();
+}
+
+/*
+ * 32 page nóng của TEST_FILE đọc hai lần theo bước nhảy 5 (không tuần tự),
+ * rồi 256 page của TEST_FILE2 đọc từng 1 KB, tuần tự hoặc theo bước nhảy 5.
+ * Trả về số hit khi đọc lại tập nóng, -1 nếu lỗi hoặc stream_inserts sai.
+ */
+static int hot_hits_after_stream(int policy, int sequential) {
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 64;
+    config.policy = policy;
+
+    if (vtpc_init_ex(&config) < 0) {
+        return -1;
+    }
+
+    create_test_file(TEST_FILE, 32 * 4096);
+    create_test_file(TEST_FILE2, 256 * 4096);
+    int hot = vtpc_open(TEST_FILE);
+    int etl = vtpc_open(TEST_FILE2);
+    char buf[1024];
+
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 32; i++) {
+            vtpc_lseek(hot, (off_t)(i * 5 % 32) * 4096, SEEK_SET);
+            vtpc_read(hot, buf, sizeof(buf));
+        }
+    }
+
+    for (int i = 0; i < 256; i++) {
+        off_t block = sequential ? i : i * 5 % 256;
+
+        vtpc_lseek(etl, block * 4096, SEEK_SET);
+        for (int part = 0; part < 4; part++) {
+            vtpc_read(etl, buf, sizeof(buf));
+        }
+    }
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+    if ((stats.stream_inserts > 0) != (sequential != 0)) {
+        vtpc_close(hot);
+        vtpc_close(etl);
+        return -1;
+    }
+
+    vtpc_reset_stats();
+    for (int i = 0; i < 32; i++) {
+        vtpc_lseek(hot, (off_t)(i * 5 % 32) * 4096, SEEK_SET);
+        if (vtpc_read(hot, buf, sizeof(buf)) != sizeof(buf) || buf[1] != 1) {
+            vtpc_close(hot);
+            vtpc_close(etl);
+            return -1;
+        }
+    }
+
+    vtpc_get_stats(&stats);
+
+    vtpc_close(hot);
+    vtpc_close(etl);
+    cleanup_test_files();
+
+    return (int)stats.cache_hits;
+}
+
+static void test_sequential_scan(void) {
+    TEST_START("Sequential scan does not flush the hot set");
+
+    int policies[] = { VTPC_POLICY_SECOND_CHANCE, VTPC_POLICY_ARC, VTPC_POLICY_S3FIFO };
+
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); p++) {
+        if (hot_hits_after_stream(policies[p], 1) != 32) {
+            TEST_FAIL("Hot pages were evicted by a sequential scan");
+            vtpc_destroy();
+            return;
+        }
+    }
+
+    /* Cùng các page nhưng không theo thứ tự: không được coi là quét */
+    int hits = hot_hits_after_stream(VTPC_POLICY_SECOND_CHANCE, 0);
+    if (hits < 0 || hits >= 32) {
+        TEST_FAIL("Random reads were treated as a stream");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_destroy();
+    TEST_PASS();
+}
+
+static void *concurrent_writer(void *arg) {
+    thread_arg_t *t = (thread_arg_t *)arg;
+
+    int fd = vtpc_open(t->path);
+    if (fd < 0) {
+        t->errors++;
+        return NULL;
+    }
+
+    char buf[4096];
+
+    for (int i = 0; i < 64; i++) {
+        memset(buf, (char)(i + fd), sizeof(buf));
+        if (vtpc_write(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+            t->errors++;
+        }
+    }
+
+    for (int i = 63; i >= 0; i--) {
+        vtpc_lseek(fd, (off_t)i * 4096, SEEK_SET);
+        if (vtpc_read(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf) ||
+            buf[0] != (char)(i + fd) || buf[4095] != (char)(i + fd)) {
+            t->errors++;
+        }
+    }
+
+    vtpc_close(fd);
+    return NULL;
+}
+
+static void test_concurrent_writeback(void) {
+    TEST_START("Concurrent writes with dirty eviction");
+
+    vtpc_destroy();
+    vtpc_init(32, 4096);
+
+    char paths[NUM_THREADS][32];
+    pthread_t threads[NUM_THREADS];
+    thread_arg_t args[NUM_THREADS];
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        snprintf(paths[i], sizeof(paths[i]), "test_mt_%d.tmp", i);
+        unlink(paths[i]);
+        args[i].path = paths[i];
+        args[i].errors = 0;
+    }
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_create(&threads[i], NULL, concurrent_writer, &args[i]);
+    }
+
+    int errors = 0;
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        errors += args[i].errors;
+        unlink(paths[i]);
+    }
+
+    vtpc_stats_t stats;
+    vtpc_get_stats(&stats);
+
+    if (errors != 0) {
+        TEST_FAIL("Data lost across concurrent writeback");
+        vtpc_destroy();
+        return;
+    }
+
+    if (stats.pages_written_back == 0) {
+        TEST_FAIL("Dirty pages were never written back");
+        vtpc_destroy();
+        return;
+    }
+
+    vtpc_destroy();
+    TEST_PASS();
+}
+
+/*
+ * Page dirty của /dev/full không ghi xuống được (ENOSPC). Khi nó thành
+ * victim, miss của file khác phải lấy page khác thay vì thất bại theo.
+ */
+static const char *reads_past_unwritable_victim(int policy) {
+    vtpc_destroy();
+
+    vtpc_config_t config;
+    vtpc_config_init(&config);
+    config.cache_size_pages = 8;
+    config.policy = policy;
+    config.readahead_pages = 0;
+    config.reclaim_low_ratio = 0;
+    config.writeback_interval_ms = 0;
+    config.dirty_ratio = 100;
+    if (vtpc_init_ex(&config) < 0) {
+        return "vtpc_init_ex failed";
+    }
+    vtpc_set_direct_mode(0);
+
+    int full = vtpc_open("/dev/full");
+    if (full < 0) {
+        return "open /dev/full failed";
+    }
+
+    char buf[4096];
+    memset(buf, 'D', sizeof(buf));
+    if (vtpc_write(full, buf, sizeof(buf)) != sizeof(buf)) {
+        vtpc_close(full);
+        return "write to /dev/full was not cached";
+    }
+
+    int fd = vtpc_open(TEST_FILE);
+    const char *err = NULL;
+    for (int round = 0; round < 4 && err == NULL; round++) {
+        for (int i = 0; i < 32; i++) {
+            vtpc_lseek(fd, (off_t)(i * 5 % 32) * 4096 + 3, SEEK_SET);
+            if (vtpc_read(fd, buf, 1) != 1 || buf[0] != (char)3) {
+                err = "Read failed because another page could not be written";
+                break;
+            }
+        }
+    }
+
+    vtpc_close(fd);
+    vtpc_close(full);
+    vtpc_destroy();
+
+    return err;
+}
+
+static void test_unwritable_victim(void) {
+    TEST_START("Failed victim writeback does not fail other reads");
+
+    int policies[] = { VTPC_POLICY_SECOND_CHANCE, VTPC_POLICY_ARC, VTPC_POLICY_S3FIFO };
+
+    create_test_file(TEST_FILE, 32 * 4096);
+    for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        const char *err = reads_past_unwritable_victim(policies[i]);
+        if (err != NULL) {
+            TEST_FAIL(err);
+            return;
+        }
+    }
+
+    cleanup_test_files();
+    TEST_PASS();
+}
+
 static void print_summary(void) {
     printf("\n");
     printf("  Results: %d/%d tests passed", tests_passed, tests_run);
@@ -541,10 +2445,35 @@ int main(void) {
     test_basic_write();
     test_seek();
     test_cache_hits();
+    test_metadata_overhead();
+    test_arena_config();
+    test_lazy_materialization();
     test_second_chance();
+    test_clock_reference_bit();
+    test_arc_policy();
+    test_s3fifo_policy();
+    test_admission_filter();
+    test_sequential_scan();
     test_fsync();
     test_multiple_files();
     test_large_file();
+    test_clustered_miss();
+    test_direct_bypass();
+    test_readahead();
+    test_lookaside_invalidation();
+    test_fsync_per_file();
+    test_coalesced_flush();
+    test_sector_writeback();
+    test_io_backend();
+    test_memory_storage();
+    test_async_io();
+    test_pin_unpin();
+    test_background_writeback();
+    test_background_reclaim();
+    test_concurrent_readers();
+    test_optimistic_read_race();
+    test_concurrent_writeback();
+    test_unwritable_victim();
 
     print_summary();
 
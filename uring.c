@@ -0,0 +1,271 @@
+/**
+ * uring.c - Gửi I/O theo lô qua io_uring
+ *
+ * Mỗi thread có một ring VTPC_IO_BATCH mục, tạo khi dùng lần đầu và đóng
+ * khi thread kết thúc. Gọi thẳng syscall nên không cần liburing. Kernel
+ * không có io_uring (hoặc seccomp chặn) thì uring_probe() trả về false và
+ * direct_submit() làm từng preadv/pwritev như cũ.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "vtpc_internal.h"
+
+typedef struct {
+    int fd;             /* -1 = chưa tạo hoặc không tạo được */
+    bool tried;
+
+    _Atomic unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+
+    _Atomic unsigned *cq_head;
+    _Atomic unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    size_t sq_ring_len;
+    void *cq_ring;
+    size_t cq_ring_len;
+    size_t sqes_len;
+} uring_t;
+
+static _Thread_local uring_t tls_ring;
+static pthread_key_t ring_key;
+static pthread_once_t ring_once = PTHREAD_ONCE_INIT;
+
+static void ring_unmap(uring_t *ring) {
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_len);
+    }
+    if (ring->cq_ring != NULL && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_len);
+    }
+    if (ring->sq_ring != NULL) {
+        munmap(ring->sq_ring, ring->sq_ring_len);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+
+    ring->sqes = NULL;
+    ring->sq_ring = NULL;
+    ring->cq_ring = NULL;
+    ring->fd = -1;
+}
+
+/* Destructor của pthread key: chạy khi thread có ring kết thúc */
+static void ring_release(void *arg) {
+    ring_unmap(arg);
+}
+
+static void ring_key_init(void) {
+    pthread_key_create(&ring_key, ring_release);
+}
+
+static int ring_setup(uring_t *ring) {
+    struct io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+
+    ring->fd = (int)syscall(__NR_io_uring_setup, VTPC_IO_BATCH, &params);
+    if (ring->fd < 0) {
+        return -1;
+    }
+
+    ring->sq_ring_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap && ring->cq_ring_len > ring->sq_ring_len) {
+        ring->sq_ring_len = ring->cq_ring_len;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        ring_unmap(ring);
+        return -1;
+    }
+
+    if (single_mmap) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_len, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            ring_unmap(ring);
+            return -1;
+        }
+    }
+
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        ring_unmap(ring);
+        return -1;
+    }
+
+    char *sq = ring->sq_ring;
+    char *cq = ring->cq_ring;
+
+    ring->sq_tail = (_Atomic unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (_Atomic unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (_Atomic unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return 0;
+}
+
+/* Ring của thread hiện tại, NULL nếu không tạo được (chỉ thử một lần) */
+static uring_t *ring_get(void) {
+    uring_t *ring = &tls_ring;
+
+    if (!ring->tried) {
+        ring->tried = true;
+        ring->fd = -1;
+        pthread_once(&ring_once, ring_key_init);
+        if (ring_setup(ring) == 0) {
+            pthread_setspecific(ring_key, ring);
+        }
+    }
+
+    return (ring->fd >= 0) ? ring : NULL;
+}
+
+bool uring_probe(void) {
+    return ring_get() != NULL;
+}
+
+/* Lấy mọi CQE đang có mà không vào kernel; trả về số CQE đã lấy */
+static size_t ring_reap(uring_t *ring, io_req_t *reqs) {
+    unsigned head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(ring->cq_tail, memory_order_acquire);
+    size_t reaped = 0;
+
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+        io_req_t *req = &reqs[cqe->user_data];
+
+        req->result = (cqe->res < 0) ? -1 : cqe->res;
+        req->error = (cqe->res < 0) ? -cqe->res : 0;
+        head++;
+        reaped++;
+    }
+
+    atomic_store_explicit(ring->cq_head, head, memory_order_release);
+
+    return reaped;
+}
+
+/* Số lần thử lại liên tiếp khi io_uring_enter báo EAGAIN/EBUSY */
+#define URING_MAX_RETRIES 16
+
+/*
+ * Ring bị bỏ giữa chừng: rút các SQE kernel chưa nhận rồi chờ các yêu cầu
+ * đã gửi xong, vì chúng vẫn dùng buffer của caller. Chờ cũng lỗi mãi thì
+ * đóng ring, thread này từ đó làm đồng bộ.
+ */
+static void ring_abandon(uring_t *ring, io_req_t *reqs, unsigned first,
+                         size_t submitted, size_t reaped) {
+    int retries = 0;
+
+    atomic_store_explicit(ring->sq_tail, first + (unsigned)submitted, memory_order_release);
+
+    while (reaped < submitted) {
+        int ret = (int)syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS,
+                               NULL, 0);
+        if (ret < 0 && errno != EINTR && ++retries >= URING_MAX_RETRIES) {
+            ring_unmap(ring);
+            return;
+        }
+        reaped += ring_reap(ring, reqs);
+    }
+}
+
+/*
+ * Gửi n <= VTPC_IO_BATCH yêu cầu rồi lấy kết quả khi chúng xong: lần vào
+ * kernel để gửi không chờ, sau đó mỗi lần chờ chỉ đợi một CQE và lấy hết
+ * các CQE đã có. Trả về -1 nếu thread không có ring hoặc kernel từ chối
+ * gửi; caller khi đó làm lại cả lô đồng bộ (đọc/ghi lại cùng dữ liệu vào
+ * cùng chỗ nên yêu cầu đã xong qua ring không bị ảnh hưởng).
+ */
+int uring_submit(io_req_t *reqs, size_t n) {
+    uring_t *ring = ring_get();
+    if (ring == NULL) {
+        errno = ENOSYS;
+        return -1;
+    }
+
+    unsigned first = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+    unsigned tail = first;
+
+    for (size_t i = 0; i < n; i++) {
+        unsigned idx = tail & ring->sq_mask;
+        struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = reqs[i].write ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->fd = reqs[i].real_fd;
+        sqe->off = (uint64_t)reqs[i].offset;
+        sqe->addr = (uint64_t)(uintptr_t)reqs[i].iov;
+        sqe->len = (unsigned)reqs[i].iovcnt;
+        sqe->user_data = i;
+        ring->sq_array[idx] = idx;
+        tail++;
+    }
+
+    atomic_store_explicit(ring->sq_tail, tail, memory_order_release);
+
+    size_t submitted = 0;
+    size_t reaped = 0;
+    int retries = 0;
+
+    for (;;) {
+        reaped += ring_reap(ring, reqs);
+        if (reaped == n) {
+            return 0;
+        }
+
+        /* Còn SQE chưa được nhận thì chỉ gửi; gửi hết rồi mới chờ */
+        bool wait = (submitted == n);
+        int ret = (int)syscall(__NR_io_uring_enter, ring->fd, (unsigned)(n - submitted),
+                               wait ? 1u : 0u, wait ? IORING_ENTER_GETEVENTS : 0u, NULL, 0);
+        /* Gửi mà kernel không nhận SQE nào cũng tính như EAGAIN */
+        if (ret == 0 && !wait) {
+            ret = -1;
+            errno = EAGAIN;
+        }
+        if (ret < 0) {
+            if (errno == EINTR ||
+                ((errno == EAGAIN || errno == EBUSY) && ++retries < URING_MAX_RETRIES)) {
+                continue;
+            }
+            int saved_errno = errno;
+            ring_abandon(ring, reqs, first, submitted, reaped);
+            errno = saved_errno;
+            return -1;
+        }
+
+        retries = 0;
+        if (!wait) {
+            atomic_fetch_add(&g_cache.uring_submits, 1);
+            submitted += (size_t)ret;
+        }
+    }
+}
@@ -3,6 +3,7 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
@@ -29,7 +30,129 @@ file_entry_t *get_file_entry(int fd) {
     return &g_cache.files[fd];
 }
 
+/*
+ * Gọi dưới file->lock cho mỗi block được đọc. Đọc tiếp trong cùng block
+ * không làm đứt chuỗi; nhảy tới block khác bắt đầu chuỗi mới. File được
+ * coi là đang đọc tuần tự sau VTPC_SEQ_MIN_RUN page liên tiếp. Lần đầu
+ * chạm một page đã có trong cache vẫn là hit bình thường, nên quét lặp
+ * lại một vùng nhỏ vẫn giữ được nó.
+ */
+static unsigned file_note_read(file_entry_t *file, off_t block_num) {
+    bool reread = false;
+
+    if (block_num == file->seq_next_block) {
+        if (file->seq_run < VTPC_SEQ_MIN_RUN) {
+            file->seq_run++;
+        }
+        file->seq_next_block = block_num + 1;
+    } else if (block_num == file->seq_next_block - 1) {
+        reread = true;
+    } else {
+        file->seq_run = 1;
+        file->seq_next_block = block_num + 1;
+    }
+
+    if (file->seq_run < VTPC_SEQ_MIN_RUN) {
+        return 0;
+    }
+    return reread ? (ACCESS_STREAM | ACCESS_REREAD) : ACCESS_STREAM;
+}
+
+/* Yêu cầu đủ lớn và căn đúng để thử đi thẳng xuống thiết bị */
+static bool bypass_eligible(file_entry_t *file, const void *buf, size_t pages) {
+    size_t page_size = g_cache.page_size;
+
+    if (g_cache.bypass_pages == 0 || pages < g_cache.bypass_pages ||
+        file->file_offset % (off_t)page_size != 0) {
+        return false;
+    }
+    return !file->direct || (uintptr_t)buf % page_size == 0;
+}
+
+/*
+ * Số page đầy từ file_offset có thể đi thẳng giữa buf và thiết bị, hoặc 0.
+ * Chỉ dải page liên tiếp chưa có trong cache và dài ít nhất bypass_pages
+ * được dùng; page đang thường trú (có thể dirty) vẫn đi qua cache. Gọi
+ * dưới file->lock.
+ */
+static size_t bypass_run(file_entry_t *file, int fd, const void *buf, size_t pages) {
+    /* Ghi thẳng bỏ các page của dải khỏi cache, kể cả page đang bị pin */
+    if (!bypass_eligible(file, buf, pages) || atomic_load(&file->pins) > 0) {
+        return 0;
+    }
+
+    size_t run = cache_uncached_run(fd, file->file_offset / (off_t)g_cache.page_size, pages);
+
+    return (run >= g_cache.bypass_pages) ? run : 0;
+}
+
+/*
+ * Chép từ page đã pin của block tại file_offset rồi nhả page và tiến offset.
+ * Gọi dưới file->lock; trả về số byte đã chép.
+ */
+static size_t read_from_page(file_entry_t *file, int fd, page_id_t page, char *dst,
+                             size_t remaining) {
+    size_t page_size = g_cache.page_size;
+    off_t block_num = file->file_offset / (off_t)page_size;
+    size_t offset_in_block = file->file_offset % page_size;
+    size_t to_read = page_size - offset_in_block;
+
+    if (to_read > remaining) {
+        to_read = remaining;
+    }
+    if (file->file_offset + (off_t)to_read > file->file_size) {
+        to_read = (size_t)(file->file_size - file->file_offset);
+    }
+
+    memcpy(dst, (char *)cache_page_data(page) + offset_in_block, to_read);
+
+    cache_lookaside_fill(fd, block_num, page);
+    cache_put_page(page, false);
+
+    file->file_offset += (off_t)to_read;
+
+    return to_read;
+}
+
+void vtpc_config_init(vtpc_config_t *config) {
+    config->cache_size_pages = VTPC_DEFAULT_CACHE_SIZE;
+    config->page_size = VTPC_DEFAULT_PAGE_SIZE;
+    config->huge_pages = 1;
+    config->lock_memory = 0;
+    config->policy = VTPC_POLICY_SECOND_CHANCE;
+    config->admission = 0;
+    config->bypass_pages = VTPC_DEFAULT_BYPASS_PAGES;
+    config->readahead_pages = VTPC_DEFAULT_READAHEAD_PAGES;
+    config->writeback_interval_ms = VTPC_DEFAULT_WRITEBACK_INTERVAL_MS;
+    config->dirty_expire_ms = VTPC_DEFAULT_DIRTY_EXPIRE_MS;
+    config->dirty_background_ratio = VTPC_DEFAULT_DIRTY_BACKGROUND_RATIO;
+    config->dirty_ratio = VTPC_DEFAULT_DIRTY_RATIO;
+    config->reclaim_low_ratio = VTPC_DEFAULT_RECLAIM_LOW_RATIO;
+    config->io_backend = VTPC_IO_AUTO;
+    config->storage = VTPC_STORAGE_POSIX;
+    config->storage_latency_us = 0;
+    config->storage_bandwidth_mb = 0;
+}
+
 int vtpc_init(size_t cache_size_pages, size_t page_size) {
+    vtpc_config_t config;
+
+    vtpc_config_init(&config);
+    config.cache_size_pages = cache_size_pages;
+    config.page_size = page_size;
+
+    return vtpc_init_ex(&config);
+}
+
+int vtpc_init_ex(const vtpc_config_t *config) {
+    if (config == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t cache_size_pages = config->cache_size_pages;
+    size_t page_size = config->page_size;
+
     if (g_cache.initialized) {
         errno = EALREADY;
         return -1;
@@ -47,63 +170,145 @@ int vtpc_init(size_t cache_size_pages, size_t page_size) {
         return -1;
     }
 
+    if (config->dirty_ratio == 0 || config->dirty_ratio > 100 ||
+        config->dirty_background_ratio > config->dirty_ratio ||
+        config->reclaim_low_ratio > 25 ||
+        config->io_backend < VTPC_IO_AUTO || config->io_backend > VTPC_IO_URING) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    switch (config->storage) {
+        case VTPC_STORAGE_POSIX:
+            g_cache.storage = &storage_posix;
+            break;
+        case VTPC_STORAGE_MEMORY:
+            g_cache.storage = &storage_memory;
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+
+    /* io_uring chỉ gửi được tới fd thật */
+    g_cache.io_backend = VTPC_IO_SYNC;
+    if (config->io_backend != VTPC_IO_SYNC && g_cache.storage->kernel_fd && uring_probe()) {
+        g_cache.io_backend = VTPC_IO_URING;
+    } else if (config->io_backend == VTPC_IO_URING) {
+        errno = g_cache.storage->kernel_fd ? ENOSYS : EINVAL;
+        return -1;
+    }
+
+    switch (config->policy) {
+        case VTPC_POLICY_SECOND_CHANCE:
+            g_cache.policy = &policy_second_chance;
+            break;
+        case VTPC_POLICY_ARC:
+            g_cache.policy = &policy_arc;
+            break;
+        case VTPC_POLICY_S3FIFO:
+            g_cache.policy = &policy_s3fifo;
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+
+    if (g_cache.storage->start(config->storage_latency_us, config->storage_bandwidth_mb) < 0) {
+        return -1;
+    }
+
     if (pthread_mutex_init(&g_cache.lock, NULL) != 0) {
+        g_cache.storage->stop();
         return -1;
     }
 
     g_cache.cache_size = cache_size_pages;
     g_cache.page_size = page_size;
+    g_cache.use_admission = config->admission != 0;
+    g_cache.bypass_pages = config->bypass_pages;
+    atomic_store(&g_cache.pages_bypassed, 0);
+    atomic_store(&g_cache.device_reads, 0);
+    atomic_store(&g_cache.device_writes, 0);
+    atomic_store(&g_cache.write_bytes_saved, 0);
+    atomic_store(&g_cache.uring_submits, 0);
+    atomic_store(&g_cache.aio_completed_inline, 0);
+    atomic_store(&g_cache.aio_queued, 0);
+    g_cache.readahead_pages = config->readahead_pages;
+    if (g_cache.readahead_pages > cache_size_pages / VTPC_RA_CACHE_FRACTION) {
+        g_cache.readahead_pages = cache_size_pages / VTPC_RA_CACHE_FRACTION;
+    }
+    g_cache.writeback_interval_ms = config->writeback_interval_ms;
+    g_cache.dirty_expire_ms = config->dirty_expire_ms;
+    g_cache.dirty_background_pages = cache_size_pages * config->dirty_background_ratio / 100;
+    g_cache.dirty_limit_pages = cache_size_pages * config->dirty_ratio / 100;
+    if (g_cache.dirty_limit_pages == 0) {
+        g_cache.dirty_limit_pages = 1;
+    }
+    atomic_store(&g_cache.dirty_pages, 0);
+    atomic_store(&g_cache.pages_flushed_background, 0);
+    atomic_store(&g_cache.writers_throttled, 0);
+    g_cache.reclaim_low_ratio = config->reclaim_low_ratio;
+
+    if (cache_pages_init(config->huge_pages != 0, config->lock_memory != 0) < 0) {
+        pthread_mutex_destroy(&g_cache.lock);
+        g_cache.storage->stop();
+        return -1;
+    }
 
-    g_cache.pages = calloc(cache_size_pages, sizeof(cache_page_t));
-    if (g_cache.pages == NULL) {
+    if (cache_shards_init() < 0) {
+        cache_pages_destroy();
         pthread_mutex_destroy(&g_cache.lock);
+        g_cache.storage->stop();
         errno = ENOMEM;
         return -1;
     }
 
-    g_cache.free_list = NULL;
-    for (size_t i = 0; i < cache_size_pages; i++) {
-        cache_page_t *page = &g_cache.pages[i];
-
-        page->data = aligned_alloc_page(page_size);
-        if (page->data == NULL) {
-            for (size_t j = 0; j < i; j++) {
-                aligned_free_page(g_cache.pages[j].data);
-            }
-            free(g_cache.pages);
-            pthread_mutex_destroy(&g_cache.lock);
-            errno = ENOMEM;
-            return -1;
-        }
-
-        page->fd = -1;
-        page->valid = false;
-        page->dirty = false;
-        page->reference_bit = false;
-        page->queue_next = NULL;
-        page->queue_prev = NULL;
-
-        page->hash_next = g_cache.free_list;
-        g_cache.free_list = page;
+    if (pin_table_init() < 0) {
+        cache_shards_destroy();
+        cache_pages_destroy();
+        pthread_mutex_destroy(&g_cache.lock);
+        g_cache.storage->stop();
+        return -1;
     }
 
-    queue_init(&g_cache.fifo_queue);
-    memset(&g_cache.hash_table, 0, sizeof(g_cache.hash_table));
-
     for (int i = 0; i < VTPC_MAX_OPEN_FILES; i++) {
+        pthread_mutex_init(&g_cache.files[i].lock, NULL);
+        pthread_mutex_init(&g_cache.files[i].index_lock, NULL);
+        radix_init(&g_cache.files[i].page_index);
         g_cache.files[i].in_use = false;
         g_cache.files[i].real_fd = -1;
         g_cache.files[i].path = NULL;
+        atomic_store(&g_cache.files[i].ra_gen, 0);
+        g_cache.files[i].ra_inflight = 0;
+        g_cache.files[i].aio_pending = 0;
+        g_cache.files[i].closing = false;
+        atomic_store(&g_cache.files[i].pins, 0);
+    }
+
+    if (aio_start() < 0 ||
+        (g_cache.readahead_pages > 0 && readahead_start(VTPC_RA_THREADS) < 0) ||
+        (g_cache.writeback_interval_ms > 0 && writeback_start() < 0) ||
+        (g_cache.reclaim_low_ratio > 0 && reclaim_start() < 0)) {
+        aio_stop();
+        readahead_stop();
+        writeback_stop();
+        for (int i = 0; i < VTPC_MAX_OPEN_FILES; i++) {
+            radix_destroy(&g_cache.files[i].page_index);
+            pthread_mutex_destroy(&g_cache.files[i].index_lock);
+            pthread_mutex_destroy(&g_cache.files[i].lock);
+        }
+        pin_table_destroy();
+        cache_shards_destroy();
+        cache_pages_destroy();
+        pthread_mutex_destroy(&g_cache.lock);
+        g_cache.storage->stop();
+        return -1;
     }
 
-    g_cache.cache_hits = 0;
-    g_cache.cache_misses = 0;
-    g_cache.pages_evicted = 0;
-    g_cache.pages_written_back = 0;
-    g_cache.pages_used = 0;
-
     g_cache.initialized = true;
     g_cache.use_direct = 1;
+    g_cache.instance++;
 
     return 0;
 }
@@ -113,6 +318,12 @@ void vtpc_destroy(void) {
         return;
     }
 
+    /* Dừng các luồng nền trước khi đóng file; yêu cầu bất đồng bộ đang chờ vẫn được làm */
+    aio_stop();
+    readahead_stop();
+    writeback_stop();
+    reclaim_stop();
+
     pthread_mutex_lock(&g_cache.lock);
 
     for (int i = 0; i < VTPC_MAX_OPEN_FILES; i++) {
@@ -120,26 +331,26 @@ void vtpc_destroy(void) {
             cache_flush_file(i);
 
             if (g_cache.files[i].real_fd >= 0) {
-                close(g_cache.files[i].real_fd);
+                direct_close(g_cache.files[i].real_fd);
             }
             if (g_cache.files[i].path != NULL) {
                 free(g_cache.files[i].path);
             }
             g_cache.files[i].in_use = false;
         }
+        radix_destroy(&g_cache.files[i].page_index);
+        pthread_mutex_destroy(&g_cache.files[i].index_lock);
+        pthread_mutex_destroy(&g_cache.files[i].lock);
     }
 
-    if (g_cache.pages != NULL) {
-        for (size_t i = 0; i < g_cache.cache_size; i++) {
-            if (g_cache.pages[i].data != NULL) {
-                aligned_free_page(g_cache.pages[i].data);
-            }
-        }
-        free(g_cache.pages);
-        g_cache.pages = NULL;
-    }
+    pin_table_destroy();
+
+    cache_shards_destroy();
+
+    cache_pages_destroy();
+
+    g_cache.storage->stop();
 
-    g_cache.free_list = NULL;
     g_cache.initialized = false;
 
     pthread_mutex_unlock(&g_cache.lock);
@@ -173,15 +384,8 @@ int vtpc_open(const char *path) {
         return -1;
     }
 
-    int flags = O_RDWR | O_CREAT;
-    if (g_cache.use_direct) {
-        flags |= O_DIRECT;
-    }
-
-    int real_fd = open(path, flags, 0644);
-    if (real_fd < 0 && g_cache.use_direct) {
-        real_fd = open(path, O_RDWR | O_CREAT, 0644);
-    }
+    bool direct;
+    int real_fd = direct_open(path, g_cache.use_direct != 0, &direct);
     if (real_fd < 0) {
         pthread_mutex_unlock(&g_cache.lock);
         return -1;
@@ -189,15 +393,25 @@ int vtpc_open(const char *path) {
 
     off_t file_size = get_file_size(real_fd);
     if (file_size < 0) {
-        close(real_fd);
+        direct_close(real_fd);
         pthread_mutex_unlock(&g_cache.lock);
         return -1;
     }
 
     file_entry_t *file = &g_cache.files[fd];
     file->real_fd = real_fd;
+    file->direct = direct;
+    atomic_store(&file->dio_full_pages, false);
     file->file_offset = 0;
     file->file_size = file_size;
+    file->seq_next_block = 0;
+    file->seq_run = 0;
+    file->ra_size = 0;
+    file->ra_next = 0;
+    file->ra_trigger = 0;
+    file->ra_wasted_seen = 0;
+    atomic_store(&file->ra_wasted, 0);
+    atomic_store(&file->ra_pos, 0);
     file->in_use = true;
     file->path = strdup(path);
 
@@ -212,19 +426,42 @@ int vtpc_close(int fd) {
         return -1;
     }
 
+    file_entry_t *file = get_file_entry(fd);
+    if (file == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    /* Từ đây yêu cầu bất đồng bộ mới của file bị từ chối */
+    pthread_mutex_lock(&file->lock);
+    if (!file->in_use || file->closing) {
+        pthread_mutex_unlock(&file->lock);
+        errno = EBADF;
+        return -1;
+    }
+    aio_set_closing(file, true);
+    pthread_mutex_unlock(&file->lock);
+
+    /* Trước lock bảng file: callback của worker có thể gọi vtpc_open()/vtpc_close() */
+    aio_drain(file);
+
     pthread_mutex_lock(&g_cache.lock);
+    pthread_mutex_lock(&file->lock);
 
-    file_entry_t *file = get_file_entry(fd);
-    if (file == NULL || !file->in_use) {
+    /* Page đang bị pin sẽ bị bỏ khỏi cache khi đóng */
+    if (atomic_load(&file->pins) > 0) {
+        aio_set_closing(file, false);
+        pthread_mutex_unlock(&file->lock);
         pthread_mutex_unlock(&g_cache.lock);
-        errno = EBADF;
+        errno = EBUSY;
         return -1;
     }
 
+    readahead_cancel(file);
     cache_flush_file(fd);
     cache_invalidate_file(fd);
 
-    int result = close(file->real_fd);
+    int result = direct_close(file->real_fd);
 
     if (file->path != NULL) {
         free(file->path);
@@ -233,7 +470,9 @@ int vtpc_close(int fd) {
 
     file->real_fd = -1;
     file->in_use = false;
+    aio_set_closing(file, false);
 
+    pthread_mutex_unlock(&file->lock);
     pthread_mutex_unlock(&g_cache.lock);
 
     return result;
@@ -245,11 +484,16 @@ off_t vtpc_lseek(int fd, off_t offset, int whence) {
         return -1;
     }
 
-    pthread_mutex_lock(&g_cache.lock);
-
     file_entry_t *file = get_file_entry(fd);
-    if (file == NULL || !file->in_use) {
-        pthread_mutex_unlock(&g_cache.lock);
+    if (file == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    pthread_mutex_lock(&file->lock);
+
+    if (!file->in_use) {
+        pthread_mutex_unlock(&file->lock);
         errno = EBADF;
         return -1;
     }
@@ -267,20 +511,20 @@ off_t vtpc_lseek(int fd, off_t offset, int whence) {
             new_offset = file->file_size + offset;
             break;
         default:
-            pthread_mutex_unlock(&g_cache.lock);
+            pthread_mutex_unlock(&file->lock);
             errno = EINVAL;
             return -1;
     }
 
     if (new_offset < 0) {
-        pthread_mutex_unlock(&g_cache.lock);
+        pthread_mutex_unlock(&file->lock);
         errno = EINVAL;
         return -1;
     }
 
     file->file_offset = new_offset;
 
-    pthread_mutex_unlock(&g_cache.lock);
+    pthread_mutex_unlock(&file->lock);
 
     return new_offset;
 }
@@ -291,11 +535,16 @@ int vtpc_fsync(int fd) {
         return -1;
     }
 
-    pthread_mutex_lock(&g_cache.lock);
-
     file_entry_t *file = get_file_entry(fd);
-    if (file == NULL || !file->in_use) {
-        pthread_mutex_unlock(&g_cache.lock);
+    if (file == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    pthread_mutex_lock(&file->lock);
+
+    if (!file->in_use) {
+        pthread_mutex_unlock(&file->lock);
         errno = EBADF;
         return -1;
     }
@@ -303,10 +552,10 @@ int vtpc_fsync(int fd) {
     int result = cache_flush_file(fd);
 
     if (result == 0) {
-        result = fsync(file->real_fd);
+        result = direct_sync(file->real_fd);
     }
 
-    pthread_mutex_unlock(&g_cache.lock);
+    pthread_mutex_unlock(&file->lock);
 
     return result;
 }
@@ -326,11 +575,16 @@ ssize_t vtpc_read(int fd, void *buf, size_t count) {
         return 0;
     }
 
-    pthread_mutex_lock(&g_cache.lock);
-
     file_entry_t *file = get_file_entry(fd);
-    if (file == NULL || !file->in_use) {
-        pthread_mutex_unlock(&g_cache.lock);
+    if (file == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    pthread_mutex_lock(&file->lock);
+
+    if (!file->in_use) {
+        pthread_mutex_unlock(&file->lock);
         errno = EBADF;
         return -1;
     }
@@ -343,18 +597,37 @@ ssize_t vtpc_read(int fd, void *buf, size_t count) {
             break;
         }
 
-        off_t block_num = file->file_offset / (off_t)page_size;
-        size_t offset_in_block = file->file_offset % page_size;
+        size_t full_pages = (count - bytes_read) / page_size;
+        off_t pages_left = (file->file_size - file->file_offset) / (off_t)page_size;
+        if ((off_t)full_pages > pages_left) {
+            full_pages = (size_t)pages_left;
+        }
 
-        cache_page_t *page = cache_get_page(fd, block_num, true);
-        if (page == NULL) {
-            pthread_mutex_unlock(&g_cache.lock);
-            if (bytes_read > 0) {
-                return (ssize_t)bytes_read;
+        size_t run = bypass_run(file, fd, (char *)buf + bytes_read, full_pages);
+        if (run > 0) {
+            ssize_t n = direct_read_blocks(file->real_fd, file->file_offset / (off_t)page_size,
+                                           run, (char *)buf + bytes_read, page_size);
+            if (n <= 0) {
+                pthread_mutex_unlock(&file->lock);
+                if (bytes_read > 0 || n == 0) {
+                    return (ssize_t)bytes_read;
+                }
+                return -1;
             }
-            return -1;
+
+            atomic_fetch_add(&g_cache.pages_bypassed, (size_t)n / page_size);
+            bytes_read += (size_t)n;
+            file->file_offset += (off_t)n;
+
+            /* Lần đọc lớn như vậy là một lần quét */
+            file->seq_next_block = file->file_offset / (off_t)page_size;
+            file->seq_run = VTPC_SEQ_MIN_RUN;
+            continue;
         }
 
+        off_t block_num = file->file_offset / (off_t)page_size;
+        size_t offset_in_block = file->file_offset % page_size;
+
         size_t available_in_page = page_size - offset_in_block;
         size_t remaining = count - bytes_read;
         size_t to_read = (available_in_page < remaining) ? available_in_page : remaining;
@@ -363,51 +636,91 @@ ssize_t vtpc_read(int fd, void *buf, size_t count) {
             to_read = (size_t)(file->file_size - file->file_offset);
         }
 
-        if (to_read == 0) {
-            break;
-        }
+        unsigned hint = file_note_read(file, block_num);
 
-        memcpy((char *)buf + bytes_read,
-               (char *)page->data + offset_in_block,
-               to_read);
-
-        bytes_read += to_read;
-        file->file_offset += (off_t)to_read;
-    }
+        /* Phần còn lại sẽ đi thẳng xuống thiết bị, đọc trước chỉ cản đường */
+        bool note = !bypass_eligible(file, (char *)buf + bytes_read, full_pages);
+        if (note) {
+            readahead_note(file, fd, block_num, hint);
+        }
 
-    pthread_mutex_unlock(&g_cache.lock);
+        if (cache_read_optimistic(fd, block_num, offset_in_block,
+                                  (char *)buf + bytes_read, to_read, hint)) {
+            bytes_read += to_read;
+            file->file_offset += (off_t)to_read;
+            continue;
+        }
 
-    return (ssize_t)bytes_read;
-}
+        /* Các block phía sau trong cùng lần đọc được nạp chung một lần preadv */
+        off_t request_end = file->file_offset + (off_t)remaining;
+        if (request_end > file->file_size) {
+            request_end = file->file_size;
+        }
+        size_t want = (size_t)((request_end + (off_t)page_size - 1) / (off_t)page_size - block_num);
 
-ssize_t vtpc_write(int fd, const void *buf, size_t count) {
-    if (!g_cache.initialized) {
-        errno = EINVAL;
-        return -1;
-    }
+        page_id_t pages[VTPC_CLUSTER_MAX];
+        size_t n = cache_get_pages(fd, block_num, want, hint, pages);
+        if (n == 0) {
+            pthread_mutex_unlock(&file->lock);
+            if (bytes_read > 0) {
+                return (ssize_t)bytes_read;
+            }
+            return -1;
+        }
 
-    if (buf == NULL) {
-        errno = EINVAL;
-        return -1;
-    }
+        for (size_t i = 0; i < n; i++) {
+            if (i > 0) {
+                hint = file_note_read(file, block_num + (off_t)i);
+            }
+            bytes_read += read_from_page(file, fd, pages[i], (char *)buf + bytes_read,
+                                         count - bytes_read);
+        }
 
-    if (count == 0) {
-        return 0;
+        /* Cửa sổ đọc trước tính từ block cuối cùng đã đọc, không phải block đầu */
+        if (n > 1 && note) {
+            readahead_note(file, fd, block_num + (off_t)n - 1, hint);
+        }
     }
 
-    pthread_mutex_lock(&g_cache.lock);
+    pthread_mutex_unlock(&file->lock);
 
-    file_entry_t *file = get_file_entry(fd);
-    if (file == NULL || !file->in_use) {
-        pthread_mutex_unlock(&g_cache.lock);
-        errno = EBADF;
-        return -1;
-    }
+    return (ssize_t)bytes_read;
+}
 
+/* Ghi tại file_offset và tiến offset; gọi dưới file->lock */
+static ssize_t write_locked(file_entry_t *file, int fd, const void *buf, size_t count) {
     size_t bytes_written = 0;
     size_t page_size = g_cache.page_size;
 
     while (bytes_written < count) {
+        size_t run = bypass_run(file, fd, (const char *)buf + bytes_written,
+                                (count - bytes_written) / page_size);
+        if (run > 0) {
+            off_t first_block = file->file_offset / (off_t)page_size;
+            ssize_t n = direct_write_blocks(file->real_fd, first_block, run,
+                                            (const char *)buf + bytes_written, page_size);
+            if (n <= 0) {
+                if (bytes_written > 0) {
+                    return (ssize_t)bytes_written;
+                }
+                if (n == 0) {
+                    errno = EIO;
+                }
+                return -1;
+            }
+
+            /* Dải không có page nào khi bắt đầu; page được nạp từ đĩa trong lúc ghi thì đã cũ */
+            cache_invalidate_range(fd, first_block, first_block + (off_t)run - 1);
+
+            atomic_fetch_add(&g_cache.pages_bypassed, (size_t)n / page_size);
+            bytes_written += (size_t)n;
+            file->file_offset += (off_t)n;
+            if (file->file_offset > file->file_size) {
+                file->file_size = file->file_offset;
+            }
+            continue;
+        }
+
         off_t block_num = file->file_offset / (off_t)page_size;
         size_t offset_in_block = file->file_offset % page_size;
 
@@ -420,9 +733,10 @@ ssize_t vtpc_write(int fd, const void *buf, size_t count) {
             need_load = true;
         }
 
-        cache_page_t *page = cache_get_page(fd, block_num, need_load);
-        if (page == NULL) {
-            pthread_mutex_unlock(&g_cache.lock);
+        writeback_throttle();
+
+        page_id_t page = cache_get_page(fd, block_num, need_load, 0);
+        if (page == PAGE_NONE) {
             if (bytes_written > 0) {
                 return (ssize_t)bytes_written;
             }
@@ -432,12 +746,13 @@ ssize_t vtpc_write(int fd, const void *buf, size_t count) {
         size_t available_in_page = page_size - offset_in_block;
         size_t to_write = (available_in_page < remaining) ? available_in_page : remaining;
 
-        memcpy((char *)page->data + offset_in_block,
+        cache_page_write_begin(page);
+        memcpy((char *)cache_page_data(page) + offset_in_block,
                (char *)buf + bytes_written,
                to_write);
+        cache_page_write_end(page);
 
-        page->dirty = true;
-        page->reference_bit = true;
+        cache_put_page_dirty(page, offset_in_block, to_write);
 
         bytes_written += to_write;
         file->file_offset += (off_t)to_write;
@@ -447,26 +762,129 @@ ssize_t vtpc_write(int fd, const void *buf, size_t count) {
         }
     }
 
-    pthread_mutex_unlock(&g_cache.lock);
-
     return (ssize_t)bytes_written;
 }
 
+ssize_t vtpc_write(int fd, const void *buf, size_t count) {
+    if (!g_cache.initialized) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (buf == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    file_entry_t *file = get_file_entry(fd);
+    if (file == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    pthread_mutex_lock(&file->lock);
+
+    if (!file->in_use) {
+        pthread_mutex_unlock(&file->lock);
+        errno = EBADF;
+        return -1;
+    }
+
+    ssize_t result = write_locked(file, fd, buf, count);
+
+    pthread_mutex_unlock(&file->lock);
+
+    return result;
+}
+
+/* Như pwrite(): ghi tại offset mà không dời file_offset */
+ssize_t file_pwrite(int fd, const void *buf, size_t count, off_t offset) {
+    file_entry_t *file = get_file_entry(fd);
+    if (file == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+
+    pthread_mutex_lock(&file->lock);
+
+    if (!file->in_use) {
+        pthread_mutex_unlock(&file->lock);
+        errno = EBADF;
+        return -1;
+    }
+
+    off_t saved = file->file_offset;
+
+    file->file_offset = offset;
+    ssize_t result = write_locked(file, fd, buf, count);
+    file->file_offset = saved;
+
+    pthread_mutex_unlock(&file->lock);
+
+    return result;
+}
+
 int vtpc_get_stats(vtpc_stats_t *stats) {
     if (!g_cache.initialized || stats == NULL) {
         errno = EINVAL;
         return -1;
     }
 
-    pthread_mutex_lock(&g_cache.lock);
-
-    stats->cache_hits = g_cache.cache_hits;
-    stats->cache_misses = g_cache.cache_misses;
-    stats->pages_evicted = g_cache.pages_evicted;
-    stats->pages_written_back = g_cache.pages_written_back;
-    stats->current_pages_used = g_cache.pages_used;
+    memset(stats, 0, sizeof(*stats));
+
+    for (size_t i = 0; i < g_cache.num_shards; i++) {
+        cache_shard_t *shard = &g_cache.shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+
+        stats->cache_hits += shard->cache_hits;
+        stats->cache_misses += shard->cache_misses;
+        stats->pages_evicted += shard->pages_evicted;
+        stats->pages_written_back += shard->pages_written_back;
+        stats->current_pages_used += shard->pages_used;
+        stats->pages_materialized += shard->fresh_next - shard->first_page;
+        stats->admissions_accepted += shard->admissions_accepted;
+        stats->admissions_rejected += shard->admissions_rejected;
+        stats->stream_inserts += shard->stream_inserts;
+        stats->pages_prefetched += shard->pages_prefetched;
+        stats->prefetch_hits += atomic_load(&shard->prefetch_hits);
+        stats->prefetch_wasted += shard->prefetch_wasted;
+        stats->free_pages += shard->free_count;
+        stats->pages_reclaimed += shard->pages_reclaimed;
+        stats->direct_evictions += shard->direct_evictions;
+        if (shard->admission != NULL) {
+            stats->admission_sketch_bytes += admission_bytes(shard);
+        }
 
-    pthread_mutex_unlock(&g_cache.lock);
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    stats->metadata_bytes = cache_metadata_bytes();
+    stats->metadata_bytes_per_page = stats->metadata_bytes / g_cache.cache_size;
+    stats->arena_bytes = g_cache.arena_mapped;
+    stats->arena_backing = g_cache.arena_backing;
+    stats->pages_bypassed = atomic_load(&g_cache.pages_bypassed);
+    stats->device_reads = atomic_load(&g_cache.device_reads);
+    stats->device_writes = atomic_load(&g_cache.device_writes);
+    stats->write_bytes_saved = atomic_load(&g_cache.write_bytes_saved);
+    stats->io_backend = g_cache.io_backend;
+    stats->uring_submits = atomic_load(&g_cache.uring_submits);
+    stats->dirty_pages = atomic_load(&g_cache.dirty_pages);
+    stats->dirty_background_pages = g_cache.dirty_background_pages;
+    stats->dirty_limit_pages = g_cache.dirty_limit_pages;
+    stats->pages_flushed_background = atomic_load(&g_cache.pages_flushed_background);
+    stats->writers_throttled = atomic_load(&g_cache.writers_throttled);
+    stats->aio_completed_inline = atomic_load(&g_cache.aio_completed_inline);
+    stats->aio_queued = atomic_load(&g_cache.aio_queued);
+
+    pthread_mutex_lock(&g_cache.pins.lock);
+    stats->pins_active = g_cache.pins.active;
+    stats->pins_total = g_cache.pins.total;
+    pthread_mutex_unlock(&g_cache.pins.lock);
 
     return 0;
 }
@@ -476,12 +894,38 @@ void vtpc_reset_stats(void) {
         return;
     }
 
-    pthread_mutex_lock(&g_cache.lock);
-
-    g_cache.cache_hits = 0;
-    g_cache.cache_misses = 0;
-    g_cache.pages_evicted = 0;
-    g_cache.pages_written_back = 0;
-
-    pthread_mutex_unlock(&g_cache.lock);
+    for (size_t i = 0; i < g_cache.num_shards; i++) {
+        cache_shard_t *shard = &g_cache.shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+
+        shard->cache_hits = 0;
+        shard->cache_misses = 0;
+        shard->pages_evicted = 0;
+        shard->pages_written_back = 0;
+        shard->admissions_accepted = 0;
+        shard->admissions_rejected = 0;
+        shard->stream_inserts = 0;
+        shard->pages_prefetched = 0;
+        atomic_store(&shard->prefetch_hits, 0);
+        shard->prefetch_wasted = 0;
+        shard->pages_reclaimed = 0;
+        shard->direct_evictions = 0;
+
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    atomic_store(&g_cache.pages_bypassed, 0);
+    atomic_store(&g_cache.device_reads, 0);
+    atomic_store(&g_cache.device_writes, 0);
+    atomic_store(&g_cache.write_bytes_saved, 0);
+    atomic_store(&g_cache.uring_submits, 0);
+    atomic_store(&g_cache.pages_flushed_background, 0);
+    atomic_store(&g_cache.writers_throttled, 0);
+    atomic_store(&g_cache.aio_completed_inline, 0);
+    atomic_store(&g_cache.aio_queued, 0);
+
+    pthread_mutex_lock(&g_cache.pins.lock);
+    g_cache.pins.total = 0;
+    pthread_mutex_unlock(&g_cache.pins.lock);
 }
\ No newline at end of file
@@ -4,6 +4,48 @@
 #include <sys/types.h>
 #include <stddef.h>
 
+/* Loại page của kernel đứng sau arena dữ liệu (vtpc_stats_t.arena_backing) */
+#define VTPC_BACKING_4K      0
+#define VTPC_BACKING_THP     1
+#define VTPC_BACKING_HUGETLB 2
+
+/* Cách gửi I/O theo lô (vtpc_config_t.io_backend, vtpc_stats_t.io_backend) */
+#define VTPC_IO_AUTO  0     /* io_uring nếu kernel cho phép, không thì SYNC */
+#define VTPC_IO_SYNC  1     /* từng preadv/pwritev */
+#define VTPC_IO_URING 2     /* vtpc_init_ex thất bại với ENOSYS nếu không có io_uring */
+
+/* Thiết bị đứng sau cache (vtpc_config_t.storage) */
+#define VTPC_STORAGE_POSIX  0   /* file thật qua preadv/pwritev */
+#define VTPC_STORAGE_MEMORY 1   /* bản sao trong RAM của file, không ghi về đĩa; giả lập độ trễ/băng thông */
+
+/* Policy thay thế (vtpc_config_t.policy) */
+#define VTPC_POLICY_SECOND_CHANCE 0
+#define VTPC_POLICY_ARC           1
+#define VTPC_POLICY_S3FIFO        2
+
+typedef struct {
+    size_t cache_size_pages;
+    size_t page_size;
+    int huge_pages;     /* thử MAP_HUGETLB rồi THP, lỗi thì dùng page 4K */
+    int lock_memory;    /* mlock arena; vtpc_init_ex thất bại nếu không khóa được */
+    int policy;         /* VTPC_POLICY_* */
+    int admission;      /* bộ lọc nhận W-TinyLFU trước policy */
+    size_t bypass_pages;    /* read/write từ chừng này page đầy trở lên đi thẳng xuống thiết bị, 0 = tắt */
+    size_t readahead_pages; /* cửa sổ đọc trước tối đa của mỗi file, 0 = tắt */
+    unsigned writeback_interval_ms;     /* chu kỳ của luồng ghi ngầm, 0 = không có luồng */
+    unsigned dirty_expire_ms;           /* page dirty lâu hơn chừng này được ghi ngầm */
+    unsigned dirty_background_ratio;    /* % cache dirty để ghi ngầm cả page chưa hết hạn */
+    unsigned dirty_ratio;               /* % cache dirty để writer phải chờ ghi ngầm */
+    unsigned reclaim_low_ratio;         /* % page mỗi shard được giữ trống ở nền (<= 25), 0 = tắt */
+    int io_backend;                     /* VTPC_IO_* */
+    int storage;                        /* VTPC_STORAGE_* */
+    unsigned storage_latency_us;        /* VTPC_STORAGE_MEMORY: độ trễ mỗi I/O */
+    unsigned storage_bandwidth_mb;      /* VTPC_STORAGE_MEMORY: MB/s, 0 = không giới hạn */
+} vtpc_config_t;
+
+void vtpc_config_init(vtpc_config_t *config);
+
+int vtpc_init_ex(const vtpc_config_t *config);
 
 int vtpc_init(size_t cache_size_pages, size_t page_size);
 
@@ -23,12 +65,87 @@ off_t vtpc_lseek(int fd, off_t offset, int whence);
 
 int vtpc_fsync(int fd);
 
+/*
+ * Yêu cầu đọc/ghi bất đồng bộ tại offset (không dời offset của fd). Caller
+ * giữ yêu cầu và buf sống tới khi hoàn tất. Yêu cầu chờ I/O hoàn tất trên
+ * một worker: callback được gọi trên worker đó, hoặc nếu callback = NULL thì
+ * yêu cầu vào hàng hoàn tất và eventfd của vtpc_aio_fd() được báo.
+ */
+typedef struct vtpc_aio {
+    int fd;
+    void *buf;
+    size_t count;
+    off_t offset;
+    void (*callback)(struct vtpc_aio *aio);
+    void *user_data;
+    ssize_t result;             /* số byte, -1 nếu lỗi */
+    int error;                  /* errno khi result < 0 */
+    int write;                  /* nội bộ */
+    struct vtpc_aio *next;      /* nội bộ */
+} vtpc_aio_t;
+
+/*
+ * Trả về 0 nếu đã xong ngay (mọi page đều có trong cache; result đã có,
+ * không callback), 1 nếu đã xếp hàng, -1 nếu tham số sai.
+ */
+int vtpc_read_async(vtpc_aio_t *aio);
+
+int vtpc_write_async(vtpc_aio_t *aio);
+
+/*
+ * Pin page chứa offset và trả về con trỏ vào dữ liệu của nó trong cache
+ * (*len byte, tới cuối page hoặc cuối file), không chép. Page không bị
+ * evict tới vtpc_unpin(); trong lúc đó vtpc_close() của fd thất bại với
+ * EBUSY. Trả về handle, hoặc -1 (ENOBUFS khi 1/4 số page trong shard
+ * chứa page đó đã bị pin).
+ */
+int vtpc_pin(int fd, off_t offset, void **ptr, size_t *len);
+
+/* dirty != 0: dải đã trao bị sửa qua con trỏ, được ghi xuống như sau vtpc_write() */
+int vtpc_unpin(int handle, int dirty);
+
+/* eventfd (EFD_NONBLOCK) báo có yêu cầu hoàn tất chờ vtpc_aio_reap() */
+int vtpc_aio_fd(void);
+
+/* Lấy tối đa max yêu cầu đã hoàn tất theo thứ tự hoàn tất, trả về số đã lấy */
+size_t vtpc_aio_reap(vtpc_aio_t **done, size_t max);
+
 typedef struct {
     size_t cache_hits;
     size_t cache_misses;
     size_t pages_evicted;
     size_t pages_written_back;
     size_t current_pages_used;
+    size_t metadata_bytes;
+    size_t metadata_bytes_per_page;
+    size_t arena_bytes;
+    int arena_backing;
+    size_t pages_materialized;
+    size_t admission_sketch_bytes;
+    size_t admissions_accepted;     /* page ở cửa sổ thắng victim của policy */
+    size_t admissions_rejected;     /* page ở cửa sổ bị evict vì tần suất thấp hơn */
+    size_t stream_inserts;          /* page nạp khi file đang bị đọc tuần tự, chèn ở đầu bị evict */
+    size_t pages_bypassed;          /* page đi thẳng giữa buffer người dùng và thiết bị */
+    size_t pages_prefetched;        /* page được đọc trước */
+    size_t prefetch_hits;           /* page đọc trước được đọc tới */
+    size_t prefetch_wasted;         /* page đọc trước bị evict hoặc hủy khi chưa được đọc */
+    size_t device_reads;            /* yêu cầu đọc xuống thiết bị (pread/preadv hoặc SQE io_uring) */
+    size_t device_writes;           /* yêu cầu ghi xuống thiết bị (pwrite/pwritev hoặc SQE io_uring) */
+    int io_backend;                 /* VTPC_IO_SYNC hoặc VTPC_IO_URING */
+    size_t uring_submits;           /* lời gọi io_uring_enter */
+    size_t write_bytes_saved;       /* byte không phải ghi nhờ chỉ ghi sector dirty */
+    size_t dirty_pages;             /* page dirty hiện tại */
+    size_t dirty_background_pages;  /* ngưỡng ghi ngầm, tính bằng page */
+    size_t dirty_limit_pages;       /* ngưỡng writer phải chờ, tính bằng page */
+    size_t pages_flushed_background; /* page được luồng ghi ngầm ghi xuống */
+    size_t writers_throttled;       /* số lần writer phải chờ ghi ngầm */
+    size_t free_pages;              /* page trống trong free list */
+    size_t pages_reclaimed;         /* page được luồng thu hồi evict vào free list */
+    size_t direct_evictions;        /* miss phải tự tìm victim vì free list rỗng */
+    size_t aio_completed_inline;    /* yêu cầu bất đồng bộ xong ngay vì hit */
+    size_t aio_queued;              /* yêu cầu bất đồng bộ phải chờ worker */
+    size_t pins_active;             /* page đang bị vtpc_pin() giữ */
+    size_t pins_total;              /* lần vtpc_pin() thành công */
 } vtpc_stats_t;
 
 int vtpc_get_stats(vtpc_stats_t *stats);
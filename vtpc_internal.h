@@ -3,105 +3,649 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <pthread.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #define VTPC_MAX_OPEN_FILES 256
 #define VTPC_DEFAULT_CACHE_SIZE 64
 #define VTPC_DEFAULT_PAGE_SIZE 4096
-#define HASH_TABLE_SIZE 256
+#define HASH_GROUP_SIZE 16
+#define HASH_TAG_EMPTY 0x00
+#define HASH_TAG_DELETED 0x01
+#define VTPC_MAX_SHARDS 64
+#define VTPC_MIN_PAGES_PER_SHARD 64
+#define VTPC_MAX_READERS 128
+#define VTPC_L0_ENTRIES 8
+#define VTPC_HUGE_PAGE_SIZE (2u << 20)
+/* Số page liên tiếp phải đọc trước khi file bị coi là đang đọc tuần tự */
+#define VTPC_SEQ_MIN_RUN 8
+#define VTPC_DEFAULT_BYPASS_PAGES 64
+/* Số block miss liên tiếp tối đa được nạp bằng một lần preadv */
+#define VTPC_CLUSTER_MAX 32
+/*
+ * Độ mịn theo dõi dirty trong page. Bitmap tối đa VTPC_SECTOR_WORDS word:
+ * page lớn hơn 64 KB dùng sector lớn hơn (bội của 512, vẫn căn cho O_DIRECT).
+ */
+#define VTPC_SECTOR_SIZE 512
+#define VTPC_SECTOR_WORDS 2
+/* Số yêu cầu I/O tối đa của một lần gửi, cũng là kích thước ring io_uring */
+#define VTPC_IO_BATCH 64
 
-typedef struct cache_page {
-    int fd;
-    off_t block_num;
-    
-    void *data;
-    
-    bool valid;
-    bool dirty;
-    bool reference_bit;
-    
-    struct cache_page *queue_next;
-    struct cache_page *queue_prev;
-    
-    struct cache_page *hash_next;
-    
-} cache_page_t;
-
-typedef struct {
-    cache_page_t *head;
-    cache_page_t *tail;
+/*
+ * Đọc trước: chuỗi tuần tự tối thiểu, cửa sổ đầu tiên, số worker, hàng đợi.
+ * Cửa sổ không vượt quá 1/VTPC_RA_CACHE_FRACTION cache để page đọc trước
+ * đang chờ không đẩy tập nóng ra ngoài.
+ */
+#define VTPC_RA_MIN_RUN 2
+#define VTPC_RA_CACHE_FRACTION 8
+#define VTPC_RA_MIN_PAGES 4
+#define VTPC_RA_THREADS 2
+#define VTPC_RA_QUEUE 64
+#define VTPC_DEFAULT_READAHEAD_PAGES 64
+
+/*
+ * Worker cho đọc/ghi bất đồng bộ, tạo khi có yêu cầu đầu tiên phải chờ.
+ * Đường hit chỉ nhận dải tới VTPC_CLUSTER_MAX page.
+ */
+#define VTPC_AIO_THREADS 4
+
+/*
+ * Page bị vtpc_pin() giữ cùng lúc: tối đa VTPC_MAX_PINS, và trong mỗi shard
+ * tối đa 1/VTPC_PIN_CACHE_FRACTION số page của shard, vì victim chỉ được
+ * chọn trong shard của block bị miss
+ */
+#define VTPC_MAX_PINS 4096
+#define VTPC_PIN_CACHE_FRACTION 4
+
+/* Ghi ngầm: chu kỳ, tuổi page dirty và ngưỡng (% cache) mặc định */
+#define VTPC_DEFAULT_WRITEBACK_INTERVAL_MS 100
+#define VTPC_DEFAULT_DIRTY_EXPIRE_MS 1000
+#define VTPC_DEFAULT_DIRTY_BACKGROUND_RATIO 10
+#define VTPC_DEFAULT_DIRTY_RATIO 30
+
+/*
+ * Thu hồi: % page của mỗi shard được giữ trống (ngưỡng dưới, ngưỡng trên
+ * gấp đôi), chu kỳ kiểm tra và số page evict mỗi lần giữ lock shard.
+ */
+#define VTPC_DEFAULT_RECLAIM_LOW_RATIO 2
+#define VTPC_RECLAIM_INTERVAL_MS 10
+#define VTPC_RECLAIM_BATCH 32
+
+/* Gợi ý truy cập của vtpc_read() khi file đang bị đọc tuần tự */
+#define ACCESS_STREAM 0x1u  /* miss: page vào đầu bị evict của policy */
+#define ACCESS_REREAD 0x2u  /* đọc tiếp trong page hiện tại: hit không nâng hạng */
+#define ACCESS_QUIET  0x4u  /* lấy lại page vừa tự nạp: hit không được tính, không nâng hạng */
+
+typedef uint32_t page_id_t;
+
+#define PAGE_NONE UINT32_MAX
+#define PAGE_KEY_NONE UINT64_MAX
+
+/* Các bit trong page_flags[] */
+#define PAGE_VALID   0x01u
+#define PAGE_DIRTY   0x02u
+/* I/O đang chạy trên page; lock của shard không bị giữ trong lúc này */
+#define PAGE_READING 0x08u
+#define PAGE_WRITING 0x10u
+#define PAGE_BUSY    (PAGE_READING | PAGE_WRITING)
+/* Bit dành riêng cho policy thay thế (ví dụ ARC: page nằm trong T2) */
+#define PAGE_POLICY0 0x20u
+#define PAGE_POLICY1 0x40u
+#define PAGE_POLICY2 0x80u
+/* Page đang ở cửa sổ của bộ lọc nhận, chưa thuộc policy */
+#define PAGE_WINDOW  0x100u
+/* Page được đọc trước và chưa được đọc lần nào */
+#define PAGE_PREFETCHED 0x200u
+
+typedef struct {
+    page_id_t next;
+    page_id_t prev;
+} page_link_t;
+
+typedef struct {
+    page_id_t head;
+    page_id_t tail;
     size_t count;
 } page_queue_t;
 
+/*
+ * Open addressing theo nhóm 16 slot: mỗi slot có một tag 1 byte
+ * (0x80 | 7 bit cao của hash, hoặc EMPTY/DELETED) để so sánh 16 slot
+ * một lần bằng SSE2.
+ */
 typedef struct {
-    cache_page_t *buckets[HASH_TABLE_SIZE];
+    size_t capacity;
+    size_t group_mask;
+    size_t used;
+    size_t tombstones;
+    uint8_t *tags;
+    page_id_t *slots;
 } page_hash_table_t;
 
+typedef struct admission admission_t;
+
+/* Một shard sở hữu một dải page liên tiếp và có lock riêng */
 typedef struct {
+    pthread_mutex_t lock;
+
+    page_id_t first_page;
+    size_t page_count;
+
+    /* Báo khi một page hết BUSY hoặc hết bị pin */
+    pthread_cond_t io_cond;
+    atomic_int io_waiters;
+
+    /* Trạng thái riêng của policy thay thế, chỉ truy cập dưới lock */
+    void *policy_state;
+
+    /* NULL khi tắt bộ lọc nhận W-TinyLFU */
+    admission_t *admission;
+
+    page_id_t free_list;
+    size_t free_count;
+
+    /* Page dirty theo thứ tự thành dirty (page_dirty_links), head là cũ nhất */
+    page_queue_t dirty;
+    /* Victim dirty ghi lỗi liên tiếp; tới pages_used thì miss báo lỗi ghi */
+    size_t victim_write_errors;
+    /* Luồng thu hồi giữ free_count trong [free_low, free_high], 0 = tắt */
+    size_t free_low;
+    size_t free_high;
+    /* High-water mark: các page từ đây trở đi chưa từng được dùng */
+    page_id_t fresh_next;
+
+    /* Đọc không lock bởi cache_read_optimistic(), thay bằng bảng mới khi rehash */
+    page_hash_table_t *hash_table;
+
+    atomic_size_t cache_hits;
+    size_t cache_misses;
+    size_t pages_evicted;
+    size_t pages_written_back;
+    size_t pages_used;
+    size_t admissions_accepted;
+    size_t admissions_rejected;
+    size_t stream_inserts;
+    size_t pages_prefetched;
+    atomic_size_t prefetch_hits;
+    size_t prefetch_wasted;
+    size_t pages_reclaimed;
+    size_t direct_evictions;
+} __attribute__((aligned(64))) cache_shard_t;
+
+/*
+ * Policy thay thế, được cache gọi dưới lock của shard. choose_victim chỉ
+ * chọn (không gỡ) một page không bận và không bị pin; nếu page dirty, cache
+ * ghi nó xuống rồi hỏi lại. Trả về PAGE_NONE với EBUSY hoặc ENOMEM.
+ * on_insert với cold = true (page của một lần đọc tuần tự) đặt page ở đầu
+ * sắp bị evict và không nâng hạng nó.
+ */
+typedef struct {
+    const char *name;
+    /* on_hit an toàn khi không giữ lock, nên đường đọc không lock được dùng */
+    bool lockless_hit;
+    int (*init)(cache_shard_t *shard);
+    void (*destroy)(cache_shard_t *shard);
+    void (*on_hit)(cache_shard_t *shard, page_id_t page);
+    void (*on_insert)(cache_shard_t *shard, page_id_t page, bool cold);
+    page_id_t (*choose_victim)(cache_shard_t *shard);
+    void (*on_remove)(cache_shard_t *shard, page_id_t page, bool evicted);
+} cache_policy_t;
+
+extern const cache_policy_t policy_second_chance;
+extern const cache_policy_t policy_arc;
+extern const cache_policy_t policy_s3fifo;
+
+/*
+ * Thiết bị đứng sau cache. Handle (real_fd của file_entry_t) chỉ có nghĩa
+ * với backend đã mở nó. kernel_fd = handle là fd thật, io_uring dùng được.
+ * start() nhận độ trễ mỗi I/O và băng thông giả lập, backend thật bỏ qua.
+ */
+typedef struct {
+    const char *name;
+    bool kernel_fd;
+    int (*start)(unsigned latency_us, unsigned bandwidth_mb);
+    void (*stop)(void);
+    int (*open)(const char *path, bool direct, bool *opened_direct);
+    int (*close)(int handle);
+    ssize_t (*readv)(int handle, const struct iovec *iov, int iovcnt, off_t offset);
+    ssize_t (*writev)(int handle, const struct iovec *iov, int iovcnt, off_t offset);
+    off_t (*size)(int handle);
+    int (*sync)(int handle);
+} storage_backend_t;
+
+extern const storage_backend_t storage_posix;
+extern const storage_backend_t storage_memory;
+
+#define GHOST_NONE UINT32_MAX
+
+typedef struct {
+    uint64_t key;
+    uint32_t next;
+    uint32_t prev;
+} ghost_node_t;
+
+/* Thứ tự FIFO/LRU: head là key cũ nhất */
+typedef struct {
+    uint32_t head;
+    uint32_t tail;
+    size_t count;
+} ghost_list_t;
+
+typedef struct {
+    size_t capacity;
+    ghost_node_t *nodes;
+    ghost_list_t **node_list;
+    uint32_t free_node;     /* chỉ node đã từng dùng rồi được trả lại */
+    /* High-water mark: các node từ đây trở đi chưa từng được dùng */
+    uint32_t fresh_node;
+
+    /* key -> node + 1 (0 là trống) */
+    uint32_t *map;
+    size_t map_mask;
+} ghost_table_t;
+
+typedef struct {
+    void *root;
+    unsigned height;
+    size_t count;
+} radix_tree_t;
+
+typedef struct {
+    /* Bảo vệ file_offset/file_size, giữ trong suốt một lần read/write */
+    pthread_mutex_t lock;
+
+    /* Các page đang thường trú của file theo block_num; lấy sau lock của shard */
+    pthread_mutex_t index_lock;
+    radix_tree_t page_index;
+
+    /* Phát hiện đọc tuần tự và cửa sổ đọc trước, bảo vệ bởi lock */
+    off_t seq_next_block;
+    unsigned seq_run;
+    off_t ra_next;          /* block đầu tiên chưa được gửi đi đọc trước */
+    off_t ra_trigger;       /* đọc tới block này thì gửi cửa sổ kế tiếp */
+    size_t ra_size;         /* 0 = không đọc trước */
+    size_t ra_wasted_seen;
+
+    atomic_size_t ra_wasted;    /* page đọc trước bị evict khi chưa được đọc */
+    atomic_uint ra_gen;         /* tăng khi đóng file hoặc hết tuần tự, yêu cầu cũ bị bỏ */
+    _Atomic off_t ra_pos;       /* worker bỏ qua block người đọc đã đi qua */
+    int ra_inflight;            /* worker đang nạp cho file, dưới lock của readahead */
+    size_t aio_pending;         /* yêu cầu bất đồng bộ chưa xong, dưới lock của aio */
+    bool closing;               /* đang đóng: yêu cầu bất đồng bộ mới bị từ chối; ghi dưới cả lock và lock của aio */
+    atomic_size_t pins;         /* vtpc_pin() chưa nhả: chặn đóng file và ghi thẳng xuống thiết bị */
+
     int real_fd;
+    bool direct;        /* real_fd mở được bằng O_DIRECT, buffer phải căn theo page */
+    atomic_bool dio_full_pages; /* thiết bị từ chối ghi O_DIRECT nhỏ hơn page */
     off_t file_offset;
     off_t file_size;
     bool in_use;
     char *path;
 } file_entry_t;
 
+typedef struct {
+    int fd;
+    unsigned gen;
+    off_t first_block;
+    size_t nblocks;
+} readahead_req_t;
+
+/* Một lần đọc/ghi một dải liên tục của file, gửi theo lô qua direct_submit() */
+typedef struct {
+    int real_fd;
+    bool write;
+    off_t offset;
+    const struct iovec *iov;
+    int iovcnt;
+    ssize_t result;     /* như preadv/pwritev */
+    int error;          /* errno khi result < 0 */
+} io_req_t;
+
+/*
+ * Gom các đoạn đọc/ghi thành yêu cầu: đoạn nối tiếp đoạn trước trên cùng
+ * file thành một yêu cầu nhiều iovec. Đầy thì tự gửi; lỗi được giữ tới
+ * io_batch_submit().
+ */
+typedef struct {
+    io_req_t reqs[VTPC_IO_BATCH];
+    struct iovec iov[VTPC_IO_BATCH * 4];
+    size_t expected[VTPC_IO_BATCH];
+    size_t nreq;
+    size_t niov;
+    off_t end;          /* offset ngay sau yêu cầu cuối */
+    int error;          /* errno của lỗi đầu tiên, 0 = chưa lỗi */
+} io_batch_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* có yêu cầu mới hoặc stop */
+    pthread_cond_t idle;    /* một worker vừa xong một yêu cầu */
+    readahead_req_t queue[VTPC_RA_QUEUE];
+    size_t head;
+    size_t count;
+    bool stop;
+    bool running;
+    pthread_t threads[VTPC_RA_THREADS];
+    size_t nthreads;
+} readahead_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* có yêu cầu mới hoặc stop */
+    pthread_cond_t idle;    /* một yêu cầu vừa xong */
+    struct vtpc_aio *head;  /* chờ worker */
+    struct vtpc_aio *tail;
+    struct vtpc_aio *done_head;     /* xong, chờ vtpc_aio_reap() */
+    struct vtpc_aio *done_tail;
+    int event_fd;
+    bool stop;
+    bool running;
+    pthread_t threads[VTPC_AIO_THREADS];
+    size_t nthreads;
+} aio_t;
+
+/* Một lần vtpc_pin(); handle là chỉ số slot */
+typedef struct {
+    page_id_t page;         /* PAGE_NONE = slot trống */
+    int fd;
+    uint32_t offset;        /* dải đã trao cho caller trong page */
+    uint32_t len;
+    uint32_t next_free;
+} pin_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pin_t *slots;
+    size_t capacity;
+    uint32_t free_head;     /* UINT32_MAX = hết slot */
+    uint32_t *shard_pins;   /* pin đang giữ theo shard */
+    size_t active;
+    size_t total;
+} pin_table_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* hết chu kỳ, bị gọi sớm hoặc stop */
+    pthread_cond_t done;    /* vừa xong một lượt ghi */
+    unsigned long passes;
+    bool kicked;
+    bool stop;
+    bool running;
+    pthread_t thread;
+} writeback_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    /* hết chu kỳ, bị gọi sớm hoặc stop */
+    atomic_bool pending;    /* một shard đã xuống dưới free_low */
+    bool stop;
+    bool running;
+    pthread_t thread;
+} reclaim_t;
+
 typedef struct {
     size_t cache_size;
     size_t page_size;
 
-    cache_page_t *pages;
+    /*
+     * Mô tả page dạng structure-of-arrays, đánh chỉ số bằng page_id_t.
+     * Key gộp fd (8 bit cao) và block_num (56 bit) vào một uint64_t.
+     */
+    uint64_t *page_keys;
+    atomic_uint *page_flags;
+    atomic_uint *page_seq;          /* seqlock: lẻ khi đang nạp/ghi đè/tái sử dụng */
+    atomic_uint *page_generation;   /* tăng khi page đổi chủ, tag cho lookaside L0 */
+    atomic_uint *page_refcount;
+    page_link_t *page_links;        /* queue; next cũng là link của free list */
+    uint32_t *page_dirtied;         /* writeback_clock_ms() lúc page thành dirty */
+    page_link_t *page_dirty_links;  /* link trong list dirty của shard */
+    uint64_t *page_sectors;         /* bitmap sector dirty, sector_words word mỗi page */
 
-    page_queue_t fifo_queue;
+    size_t sector_size;
+    size_t sectors_per_page;
+    size_t sector_words;
 
-    cache_page_t *free_list;
+    /* Dữ liệu page i nằm ở arena + i * page_size */
+    char *arena;
+    size_t arena_mapped;
+    int arena_backing;
+    bool arena_locked;
 
-    page_hash_table_t hash_table;
+    const cache_policy_t *policy;
+    bool use_admission;
 
-    file_entry_t files[VTPC_MAX_OPEN_FILES];
+    /* Ngưỡng đi thẳng xuống thiết bị, 0 = tắt */
+    size_t bypass_pages;
+    atomic_size_t pages_bypassed;
 
-    size_t cache_hits;
-    size_t cache_misses;
-    size_t pages_evicted;
-    size_t pages_written_back;
-    size_t pages_used;
+    /* Số lời gọi đọc/ghi xuống thiết bị */
+    atomic_size_t device_reads;
+    atomic_size_t device_writes;
+    atomic_size_t write_bytes_saved;
+
+    const storage_backend_t *storage;
+
+    /* VTPC_IO_SYNC hoặc VTPC_IO_URING, chọn lúc init */
+    int io_backend;
+    atomic_size_t uring_submits;
+
+    /* Cửa sổ đọc trước tối đa đã giới hạn theo cache, 0 = tắt */
+    size_t readahead_pages;
+    readahead_t readahead;
+
+    /* Ghi ngầm; ngưỡng đã đổi sang số page */
+    unsigned writeback_interval_ms;
+    unsigned dirty_expire_ms;
+    size_t dirty_background_pages;
+    size_t dirty_limit_pages;
+    atomic_size_t dirty_pages;
+    atomic_size_t pages_flushed_background;
+    atomic_size_t writers_throttled;
+    writeback_t writeback;
+
+    /* % page của mỗi shard được giữ trống, 0 = không có luồng thu hồi */
+    unsigned reclaim_low_ratio;
+    reclaim_t reclaim;
+
+    aio_t aio;
+    atomic_size_t aio_completed_inline;
+    atomic_size_t aio_queued;
+
+    pin_table_t pins;
 
+    cache_shard_t *shards;
+    size_t num_shards;
+    size_t pages_per_shard;
+
+    file_entry_t files[VTPC_MAX_OPEN_FILES];
+
+    /* Chỉ bảo vệ bảng file (open/close/destroy) */
     pthread_mutex_t lock;
 
     bool initialized;
     int use_direct;
 
+    /* Khác nhau giữa các lần vtpc_init, để lookaside L0 cũ không khớp */
+    unsigned long instance;
+
 } cache_state_t;
 
 extern cache_state_t g_cache;
 
-cache_page_t *cache_find_page(int fd, off_t block_num);
-cache_page_t *cache_get_page(int fd, off_t block_num, bool load_from_disk);
+static inline uint64_t page_key(int fd, off_t block_num) {
+    return ((uint64_t)fd << 56) | (uint64_t)block_num;
+}
+
+static inline int page_key_fd(uint64_t key) {
+    return (int)(key >> 56);
+}
+
+static inline off_t page_key_block(uint64_t key) {
+    return (off_t)(key & ((1ULL << 56) - 1));
+}
+
+/* Key được đọc không lock bởi đường hit, nên load/store đều là atomic relaxed */
+static inline uint64_t page_key_of(page_id_t page) {
+    return __atomic_load_n(&g_cache.page_keys[page], __ATOMIC_RELAXED);
+}
+
+static inline void page_set_key(page_id_t page, uint64_t key) {
+    __atomic_store_n(&g_cache.page_keys[page], key, __ATOMIC_RELAXED);
+}
+
+static inline unsigned page_flags(page_id_t page) {
+    return atomic_load_explicit(&g_cache.page_flags[page], memory_order_relaxed);
+}
+
+static inline bool page_test(page_id_t page, unsigned flags) {
+    return (page_flags(page) & flags) != 0;
+}
+
+static inline void page_set(page_id_t page, unsigned flags) {
+    atomic_fetch_or_explicit(&g_cache.page_flags[page], flags, memory_order_relaxed);
+}
+
+static inline void page_clear(page_id_t page, unsigned flags) {
+    atomic_fetch_and_explicit(&g_cache.page_flags[page], ~flags, memory_order_relaxed);
+}
+
+/*
+ * Page có thể bị evict: không có I/O đang chạy và không ai pin. Load
+ * seq_cst để khớp với cặp io_waiters/refcount trong cache_put_page().
+ */
+static inline bool page_evictable(page_id_t page) {
+    return !page_test(page, PAGE_BUSY) && atomic_load(&g_cache.page_refcount[page]) == 0;
+}
+
+static inline void *cache_page_data(page_id_t page) {
+    return g_cache.arena + (size_t)page * g_cache.page_size;
+}
+
+int cache_pages_init(bool huge_pages, bool lock_memory);
+void cache_pages_destroy(void);
+size_t cache_metadata_bytes(void);
 
-cache_page_t *cache_evict_page(void);
+int cache_shards_init(void);
+void cache_shards_destroy(void);
+cache_shard_t *cache_shard_of(int fd, off_t block_num);
+cache_shard_t *cache_page_shard(page_id_t page);
 
-int cache_flush_page(cache_page_t *page);
+page_id_t cache_find_page(cache_shard_t *shard, uint64_t key, unsigned hint);
+page_id_t cache_get_page(int fd, off_t block_num, bool load_from_disk, unsigned hint);
+size_t cache_get_pages(int fd, off_t first_block, size_t nblocks, unsigned hint, page_id_t *pages);
+bool cache_try_get_pages(int fd, off_t first_block, size_t nblocks, page_id_t *pages);
+int cache_prefetch_pages(int fd, off_t first_block, size_t nblocks, unsigned hint);
+void cache_put_page(page_id_t page, bool dirty);
+void cache_put_page_dirty(page_id_t page, size_t offset, size_t len);
+void cache_wait_io(cache_shard_t *shard);
+
+bool cache_read_optimistic(int fd, off_t block_num, size_t offset, void *dst, size_t len,
+                           unsigned hint);
+void cache_lookaside_fill(int fd, off_t block_num, page_id_t page);
+void cache_page_write_begin(page_id_t page);
+void cache_page_write_end(page_id_t page);
+
+page_id_t cache_evict_page(cache_shard_t *shard);
+size_t cache_uncached_run(int fd, off_t first_block, size_t max_blocks);
+
+int cache_flush_page(cache_shard_t *shard, page_id_t page);
+int cache_flush_pages(cache_shard_t *shard, const page_id_t *pages, size_t n);
 int cache_flush_file(int fd);
+int cache_flush_range(int fd, off_t first_block, off_t last_block);
 void cache_invalidate_file(int fd);
+void cache_invalidate_range(int fd, off_t first_block, off_t last_block);
 
 void queue_init(page_queue_t *q);
-void queue_push_back(page_queue_t *q, cache_page_t *page);
-cache_page_t *queue_pop_front(page_queue_t *q);
-void queue_remove(page_queue_t *q, cache_page_t *page);
-void queue_move_to_back(page_queue_t *q, cache_page_t *page);
-
-uint32_t hash_function(int fd, off_t block_num);
-void hash_insert(cache_page_t *page);
-void hash_remove(cache_page_t *page);
-cache_page_t *hash_lookup(int fd, off_t block_num);
-
-void *aligned_alloc_page(size_t page_size);
-void aligned_free_page(void *ptr);
+void queue_push_back(page_queue_t *q, page_id_t page);
+void queue_push_front(page_queue_t *q, page_id_t page);
+page_id_t queue_pop_front(page_queue_t *q);
+void queue_remove(page_queue_t *q, page_id_t page);
+void queue_move_to_back(page_queue_t *q, page_id_t page);
+
+uint64_t hash_key(uint64_t key);
+uint64_t hash_function(int fd, off_t block_num);
+int hash_resize(cache_shard_t *shard, size_t capacity);
+void hash_insert(cache_shard_t *shard, page_id_t page);
+void hash_remove(cache_shard_t *shard, page_id_t page);
+page_id_t hash_lookup(cache_shard_t *shard, uint64_t key);
+
+void *arena_map(size_t bytes, bool huge_pages, size_t *mapped, int *backing);
+void arena_unmap(void *arena, size_t mapped);
+int direct_open(const char *path, bool direct, bool *opened_direct);
+int direct_close(int real_fd);
+int direct_sync(int real_fd);
 ssize_t direct_read_block(int real_fd, off_t block_num, void *buf, size_t page_size);
 ssize_t direct_write_block(int real_fd, off_t block_num, const void *buf, size_t page_size);
+ssize_t direct_read_blocks(int real_fd, off_t block_num, size_t nblocks, void *buf, size_t page_size);
+ssize_t direct_read_vec(int real_fd, off_t block_num, void *const *bufs, size_t nblocks,
+                        size_t page_size);
+ssize_t direct_write_blocks(int real_fd, off_t block_num, size_t nblocks, const void *buf,
+                            size_t page_size);
+void direct_submit(io_req_t *reqs, size_t n);
+void io_batch_init(io_batch_t *io);
+void io_batch_add(io_batch_t *io, int real_fd, bool write, off_t offset, void *buf, size_t len);
+int io_batch_submit(io_batch_t *io);
+
+bool uring_probe(void);
+int uring_submit(io_req_t *reqs, size_t n);
 off_t get_file_size(int real_fd);
 
+int admission_init(cache_shard_t *shard);
+void admission_destroy(cache_shard_t *shard);
+size_t admission_bytes(const cache_shard_t *shard);
+void admission_record(cache_shard_t *shard, uint64_t key);
+void admission_insert(cache_shard_t *shard, page_id_t page);
+void admission_remove(cache_shard_t *shard, page_id_t page);
+page_id_t admission_choose_victim(cache_shard_t *shard);
+page_id_t admission_reclaim_victim(cache_shard_t *shard);
+
+int readahead_start(size_t threads);
+void readahead_stop(void);
+void readahead_cancel(file_entry_t *file);
+void readahead_note(file_entry_t *file, int fd, off_t block_num, unsigned hint);
+
+uint32_t writeback_clock_ms(void);
+int writeback_start(void);
+void writeback_stop(void);
+void writeback_throttle(void);
+
+int reclaim_start(void);
+void reclaim_stop(void);
+void reclaim_kick(void);
+size_t cache_reclaim_shard(cache_shard_t *shard);
+
+int aio_start(void);
+void aio_stop(void);
+void aio_set_closing(file_entry_t *file, bool closing);
+void aio_drain(file_entry_t *file);
+
+int pin_table_init(void);
+void pin_table_destroy(void);
+
+int ghost_table_init(ghost_table_t *g, size_t capacity);
+void ghost_table_destroy(ghost_table_t *g);
+void ghost_list_init(ghost_list_t *list);
+ghost_list_t *ghost_find(const ghost_table_t *g, uint64_t key);
+void ghost_remove(ghost_table_t *g, uint64_t key);
+void ghost_drop_oldest(ghost_table_t *g, ghost_list_t *list);
+void ghost_push(ghost_table_t *g, ghost_list_t *list, uint64_t key);
+
+void radix_init(radix_tree_t *tree);
+void radix_destroy(radix_tree_t *tree);
+int radix_insert(radix_tree_t *tree, uint64_t key, uint32_t value);
+bool radix_lookup(const radix_tree_t *tree, uint64_t key, uint32_t *value);
+bool radix_delete(radix_tree_t *tree, uint64_t key);
+size_t radix_gather(const radix_tree_t *tree, uint64_t start,
+                    uint32_t *values, uint64_t *keys, size_t max);
+
+int epoch_enter(void);
+void epoch_exit(int slot);
+void epoch_synchronize(void);
+
 int find_free_fd_slot(void);
 file_entry_t *get_file_entry(int fd);
+ssize_t file_pwrite(int fd, const void *buf, size_t count, off_t offset);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,204 @@
+/**
+ * writeback.c - Luồng ghi ngầm page dirty
+ *
+ * Mỗi writeback_interval_ms luồng ghi các page đã dirty lâu hơn
+ * dirty_expire_ms. Khi số page dirty vượt dirty_background_pages thì ghi
+ * cả page chưa hết hạn cho tới khi xuống dưới ngưỡng. Writer chỉ phải chờ
+ * khi số page dirty chạm dirty_limit_pages.
+ */
+
+#include <time.h>
+#include <errno.h>
+
+#include "vtpc_internal.h"
+
+uint32_t writeback_clock_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    /* Tràn sau ~49 ngày; tuổi page được tính bằng phép trừ không dấu */
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000);
+}
+
+static bool over_background(void) {
+    return atomic_load(&g_cache.dirty_pages) > g_cache.dirty_background_pages;
+}
+
+/*
+ * Chỉ duyệt list dirty của shard, từ page dirty lâu nhất. Chưa vượt ngưỡng
+ * nền thì dừng ở page đầu tiên chưa hết hạn, vì các page sau còn trẻ hơn.
+ * Page đang bị pin có thể đang được writer chép vào nên được để lại cho
+ * lượt sau; fsync và eviction vẫn ghi chúng như trước. Page được chọn gom
+ * thành lô VTPC_CLUSTER_MAX page, mỗi lô một lần gửi I/O. Lock được nhả
+ * trong lúc ghi nên mỗi lô duyệt lại từ đầu list; mỗi lượt xét nhiều nhất
+ * số page đang dirty lúc bắt đầu.
+ */
+static void writeback_shard(cache_shard_t *shard, uint32_t now) {
+    page_id_t batch[VTPC_CLUSTER_MAX];
+
+    pthread_mutex_lock(&shard->lock);
+
+    size_t budget = shard->dirty.count;
+
+    while (budget > 0) {
+        size_t n = 0;
+
+        for (page_id_t page = shard->dirty.head;
+             page != PAGE_NONE && budget > 0 && n < VTPC_CLUSTER_MAX;
+             page = g_cache.page_dirty_links[page].next) {
+            if (!over_background() && now - g_cache.page_dirtied[page] < g_cache.dirty_expire_ms) {
+                budget = 0;
+                break;
+            }
+            budget--;
+
+            if (!page_test(page, PAGE_BUSY) && atomic_load(&g_cache.page_refcount[page]) == 0) {
+                batch[n++] = page;
+            }
+        }
+
+        if (n == 0) {
+            break;
+        }
+
+        int written = cache_flush_pages(shard, batch, n);
+        if (written <= 0) {
+            break;
+        }
+        atomic_fetch_add(&g_cache.pages_flushed_background, (size_t)written);
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+}
+
+static void writeback_pass(void) {
+    uint32_t now = writeback_clock_ms();
+
+    for (size_t i = 0; i < g_cache.num_shards; i++) {
+        if (atomic_load(&g_cache.dirty_pages) == 0) {
+            break;
+        }
+        writeback_shard(&g_cache.shards[i], now);
+    }
+}
+
+static void *writeback_thread(void *arg) {
+    writeback_t *wb = &g_cache.writeback;
+
+    (void)arg;
+
+    pthread_mutex_lock(&wb->lock);
+
+    for (;;) {
+        if (!wb->stop && !wb->kicked) {
+            struct timespec deadline;
+
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            deadline.tv_sec += g_cache.writeback_interval_ms / 1000;
+            deadline.tv_nsec += (long)(g_cache.writeback_interval_ms % 1000) * 1000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+
+            pthread_cond_timedwait(&wb->cond, &wb->lock, &deadline);
+        }
+        if (wb->stop) {
+            break;
+        }
+        wb->kicked = false;
+
+        pthread_mutex_unlock(&wb->lock);
+        writeback_pass();
+        pthread_mutex_lock(&wb->lock);
+
+        wb->passes++;
+        pthread_cond_broadcast(&wb->done);
+    }
+
+    pthread_mutex_unlock(&wb->lock);
+
+    return NULL;
+}
+
+int writeback_start(void) {
+    writeback_t *wb = &g_cache.writeback;
+    pthread_condattr_t attr;
+
+    wb->passes = 0;
+    wb->kicked = false;
+    wb->stop = false;
+
+    if (pthread_mutex_init(&wb->lock, NULL) != 0) {
+        return -1;
+    }
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wb->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&wb->done, NULL);
+
+    if (pthread_create(&wb->thread, NULL, writeback_thread, NULL) != 0) {
+        pthread_cond_destroy(&wb->done);
+        pthread_cond_destroy(&wb->cond);
+        pthread_mutex_destroy(&wb->lock);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    wb->running = true;
+
+    return 0;
+}
+
+/* Page còn dirty được ghi bởi vtpc_close()/vtpc_destroy() như trước */
+void writeback_stop(void) {
+    writeback_t *wb = &g_cache.writeback;
+
+    if (!wb->running) {
+        return;
+    }
+
+    pthread_mutex_lock(&wb->lock);
+    wb->stop = true;
+    pthread_cond_broadcast(&wb->cond);
+    pthread_cond_broadcast(&wb->done);
+    pthread_mutex_unlock(&wb->lock);
+
+    pthread_join(wb->thread, NULL);
+
+    pthread_cond_destroy(&wb->done);
+    pthread_cond_destroy(&wb->cond);
+    pthread_mutex_destroy(&wb->lock);
+
+    wb->running = false;
+}
+
+/*
+ * Gọi trước khi writer làm dirty thêm page. Khi đã chạm ngưỡng cứng thì
+ * đánh thức luồng ghi ngầm và chờ nhiều nhất một lượt ghi của nó.
+ */
+void writeback_throttle(void) {
+    writeback_t *wb = &g_cache.writeback;
+
+    if (!wb->running || atomic_load(&g_cache.dirty_pages) < g_cache.dirty_limit_pages) {
+        return;
+    }
+
+    atomic_fetch_add(&g_cache.writers_throttled, 1);
+
+    pthread_mutex_lock(&wb->lock);
+
+    unsigned long pass = wb->passes;
+
+    wb->kicked = true;
+    pthread_cond_signal(&wb->cond);
+
+    while (!wb->stop && wb->passes == pass &&
+           atomic_load(&g_cache.dirty_pages) >= g_cache.dirty_limit_pages) {
+        pthread_cond_wait(&wb->done, &wb->lock);
+    }
+
+    pthread_mutex_unlock(&wb->lock);
+}